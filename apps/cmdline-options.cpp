@@ -14,7 +14,10 @@
  * You should have received a copy of the GNU General Public License
  * along with this program.  If not, see <http://www.gnu.org/licenses/>. */
 
+#include <stdlib.h>
+#include <algorithm>
 #include <limits>
+#include <vector>
 
 #include <cxxopts/cxxopts.hpp>
 
@@ -26,6 +29,7 @@
 
 #define HELP "help"
 #define VERBOSE "verbose"
+#define STATE_DIR "state-dir"
 
 #define LIST_DEVICES "list-devices"
 #define DEVICE "device"
@@ -36,15 +40,43 @@
 #define FULLSCREEN "fullscreen"
 #define VSYNC "vsync"
 #define MAX_FPS "fps-max"
+#define RENDER_SCALE "render-scale"
+#define RENDER_FILTER "render-filter"
 
 #define BUCKET_COUNT "buckets"
 #define BUCKET_BASS_EXAGGERATION "bass-width"
 
+#define FFT_ENGINE "fft-engine"
+#define FFT_SIZE "fft-size"
+#define FFT_HOP "hop"
+#define FFT_WINDOW "window"
+#define FFT_PRECISION "precision"
+#define FFT_PLANNER "planner"
+#define FFT_THREADS "fft-threads"
+
+#ifdef SOUNDVIEW_FFTW
+#define FFT_ENGINE_DEFAULT "fftw"
+#else
+#define FFT_ENGINE_DEFAULT "builtin"
+#endif
+
+#if defined(SOUNDVIEW_FFTW_FLOAT) || !defined(SOUNDVIEW_FFTW)
+#define FFT_PRECISION_DEFAULT "float"
+#else
+#define FFT_PRECISION_DEFAULT "double"
+#endif
+
 #define COLOR_LUM_EXAGGERATION "lum-exaggeration"
 #define COLOR_MAX_LUM "max-lum"
+#define COLOR_PALETTE "palette"
+#define COLOR_LUT_SIZE "palette-size"
 
 #define ANALYZER_WIDTH_PCT "analyzer-width"
 #define VOICEPRINT_SCROLL_RATE "voiceprint-scroll"
+#define VOICEPRINT_RENDERER "voiceprint-renderer"
+#define VOICEPRINT_HISTORY_SECS "voiceprint-history"
+#define SCROLLBACK_MINUTES "scrollback"
+#define SCROLLBACK_MB "scrollback-mb"
 #define LOUDNESS_ADJUST_RATE "loudness-adjust"
 
 
@@ -63,6 +95,39 @@ namespace {
     return val;
   }
 
+  std::string get_choice(cxxopts::Options& options, const char* name,
+      const std::vector<std::string>& choices) {
+    std::string val = options[name].as<std::string>();
+    if (std::find(choices.begin(), choices.end(), val) == choices.end()) {
+      std::ostringstream oss;
+      for (size_t i = 0; i < choices.size(); ++i) {
+        oss << ((i == 0) ? "" : ",") << choices[i];
+      }
+      ERROR("Value must be one of [%s]: %s = %s", oss.str().c_str(), name, val.c_str());
+      exit(1);
+    }
+    return val;
+  }
+
+  std::string get_default_state_dir() {
+#ifdef WIN32
+    const char* base = getenv("LOCALAPPDATA");
+    if (base != NULL && base[0] != '\0') {
+      return std::string(base) + "\\soundview";
+    }
+#else
+    const char* base = getenv("XDG_CACHE_HOME");
+    if (base != NULL && base[0] != '\0') {
+      return std::string(base) + "/soundview";
+    }
+    base = getenv("HOME");
+    if (base != NULL && base[0] != '\0') {
+      return std::string(base) + "/.cache/soundview";
+    }
+#endif
+    return std::string();
+  }
+
   std::string get_version() {
     std::ostringstream oss;
     oss << "\n  v" << config::VERSION_STRING << " (" << config::BUILD_DATE << ")";
@@ -79,6 +144,9 @@ CmdlineOptions::CmdlineOptions(int argc, char* argv[])
         "Displays this message")
     ("v," VERBOSE,
         "Enables verbose logging")
+    (STATE_DIR,
+        "Directory for state which is kept across runs, such as FFT plans. Empty to disable.",
+        cxxopts::value<std::string>()->default_value(get_default_state_dir()))
     ;
 
   options->add_options("Device selection")
@@ -99,6 +167,38 @@ CmdlineOptions::CmdlineOptions(int argc, char* argv[])
         cxxopts::value<size_t>()->default_value("176400"))
     ;
 
+  options->add_options("Analysis")
+    (FFT_ENGINE,
+        "Which FFT implementation to use: fftw, builtin (power-of-two sizes only), or q15 "
+        "(16-bit fixed point, for CPUs with slow floating point).",
+        cxxopts::value<std::string>()->default_value(FFT_ENGINE_DEFAULT))
+    (FFT_SIZE,
+        "Number of samples in each FFT frame, rounded to the nearest size which the "
+        "--" FFT_ENGINE " handles quickly (powers of two for builtin and q15). The resulting "
+        "frequencies are resampled to --" BUCKET_COUNT ". 0 = automatic, 2x --" BUCKET_COUNT ".",
+        cxxopts::value<size_t>()->default_value("0"))
+    (FFT_HOP,
+        "How many new samples to collect between FFT frames. Values smaller than "
+        "--" FFT_SIZE " produce overlapping frames at a higher rate. "
+        "0 = automatic, one frame per display refresh (--" AUDIO_SAMPLE_RATE " / --" MAX_FPS ").",
+        cxxopts::value<size_t>()->default_value("0"))
+    (FFT_WINDOW,
+        "Window function applied to each FFT frame: hann, blackman, or none.",
+        cxxopts::value<std::string>()->default_value("hann"))
+    (FFT_PRECISION,
+        "Precision to use for FFT frames: float or double. Float is faster but needs a build "
+        "with libfftw3f support when using the fftw engine. Ignored by the q15 engine.",
+        cxxopts::value<std::string>()->default_value(FFT_PRECISION_DEFAULT))
+    (FFT_PLANNER,
+        "How hard FFTW should look for a fast FFT plan: estimate, measure, patient, or exhaustive. "
+        "Slower planners are only slow the first time, since plans are cached in --" STATE_DIR ".",
+        cxxopts::value<std::string>()->default_value("measure"))
+    (FFT_THREADS,
+        "Number of threads to use when transforming a batch of frames which all arrived at once. "
+        "Only helps with a small --" FFT_HOP " relative to --" AUDIO_COLLECT_RATE ".",
+        cxxopts::value<size_t>()->default_value("1"))
+    ;
+
   options->add_options("Display")
     ("f," FULLSCREEN,
         "Run in fullscreen mode.")
@@ -107,6 +207,13 @@ CmdlineOptions::CmdlineOptions(int argc, char* argv[])
     (MAX_FPS,
         "Maximum FPS to use for the display. Too high just wastes CPU.",
         cxxopts::value<size_t>()->default_value("60"))
+    (RENDER_SCALE,
+        "Resolution to render at, as a percentage of the window size. The result is scaled up to "
+        "fill the window.",
+        cxxopts::value<size_t>()->default_value("100"))
+    (RENDER_FILTER,
+        "How to scale up the display when --" RENDER_SCALE " is below 100: 'nearest' or 'linear'.",
+        cxxopts::value<std::string>()->default_value("linear"))
     ;
 
   options->add_options("Appearance")
@@ -123,6 +230,12 @@ CmdlineOptions::CmdlineOptions(int argc, char* argv[])
     (COLOR_MAX_LUM,
         "Maximum luminosity value to be displayed.",
         cxxopts::value<size_t>()->default_value("50"))
+    (COLOR_PALETTE,
+        "Colors to use for displaying values: 'hsl', 'viridis', 'magma', or 'grayscale'.",
+        cxxopts::value<std::string>()->default_value("hsl"))
+    (COLOR_LUT_SIZE,
+        "Number of distinct colors to precompute for the palette.",
+        cxxopts::value<size_t>()->default_value("1024"))
 
     (ANALYZER_WIDTH_PCT,
         "Width of the spectrum analyzer, as a percentage of the screen.",
@@ -130,6 +243,19 @@ CmdlineOptions::CmdlineOptions(int argc, char* argv[])
     (VOICEPRINT_SCROLL_RATE,
         "How quickly voiceprint should scroll.",
         cxxopts::value<size_t>()->default_value("3"))
+    (VOICEPRINT_RENDERER,
+        "How to draw new voiceprint columns: 'pixels' writes them directly into the texture, "
+        "'quads' draws a shape for each bucket.",
+        cxxopts::value<std::string>()->default_value("pixels"))
+    (VOICEPRINT_HISTORY_SECS,
+        "Seconds of voiceprint to keep for redrawing after the window is resized or rotated.",
+        cxxopts::value<size_t>()->default_value("120"))
+    (SCROLLBACK_MINUTES,
+        "Minutes of zoomed-out voiceprint to keep for scrolling back with the arrow keys.",
+        cxxopts::value<size_t>()->default_value("60"))
+    (SCROLLBACK_MB,
+        "Limit on memory used by --" SCROLLBACK_MINUTES ", in MB.",
+        cxxopts::value<size_t>()->default_value("128"))
     (LOUDNESS_ADJUST_RATE,
         "How quickly to recover levels following a loud noise.",
         cxxopts::value<size_t>()->default_value("3"))
@@ -160,6 +286,10 @@ std::string CmdlineOptions::device() const {
   return (*options)[DEVICE].as<std::string>();
 }
 
+std::string CmdlineOptions::state_dir() const {
+  return (*options)[STATE_DIR].as<std::string>();
+}
+
 size_t CmdlineOptions::audio_collect_rate_hz() const {
   return get_uint(*options, AUDIO_COLLECT_RATE, 1);
 }
@@ -176,6 +306,12 @@ bool CmdlineOptions::display_vsync() const {
 bool CmdlineOptions::display_fullscreen() const {
   return (*options)[FULLSCREEN].as<bool>();
 }
+size_t CmdlineOptions::display_render_scale() const {
+  return get_uint(*options, RENDER_SCALE, 1, 100);
+}
+std::string CmdlineOptions::display_render_filter() const {
+  return get_choice(*options, RENDER_FILTER, {"nearest", "linear"});
+}
 
 size_t CmdlineOptions::bucket_count() const {
   return get_uint(*options, BUCKET_COUNT, 1);
@@ -184,12 +320,49 @@ size_t CmdlineOptions::bucket_bass_exaggeration() const {
   return get_uint(*options, BUCKET_BASS_EXAGGERATION, 0, 900);
 }
 
+std::string CmdlineOptions::fft_engine() const {
+#ifdef SOUNDVIEW_FFTW
+  return get_choice(*options, FFT_ENGINE, {"fftw", "builtin", "q15"});
+#else
+  return get_choice(*options, FFT_ENGINE, {"builtin", "q15"});
+#endif
+}
+size_t CmdlineOptions::fft_size() const {
+  return get_uint(*options, FFT_SIZE, 0);
+}
+size_t CmdlineOptions::fft_hop() const {
+  return get_uint(*options, FFT_HOP, 0);
+}
+std::string CmdlineOptions::fft_window() const {
+  return get_choice(*options, FFT_WINDOW, {"hann", "blackman", "none"});
+}
+std::string CmdlineOptions::fft_precision() const {
+#ifndef SOUNDVIEW_FFTW_FLOAT
+  if (fft_engine() == "fftw") {
+    return get_choice(*options, FFT_PRECISION, {"double"});
+  }
+#endif
+  return get_choice(*options, FFT_PRECISION, {"float", "double"});
+}
+std::string CmdlineOptions::fft_planner() const {
+  return get_choice(*options, FFT_PLANNER, {"estimate", "measure", "patient", "exhaustive"});
+}
+size_t CmdlineOptions::fft_threads() const {
+  return get_uint(*options, FFT_THREADS, 1, 256);
+}
+
 size_t CmdlineOptions::color_lum_exaggeration() const {
   return get_uint(*options, COLOR_LUM_EXAGGERATION, 0, 100);
 }
 size_t CmdlineOptions::color_max_lum() const {
   return get_uint(*options, COLOR_MAX_LUM, 0);
 }
+std::string CmdlineOptions::color_palette() const {
+  return get_choice(*options, COLOR_PALETTE, {"hsl", "viridis", "magma", "grayscale"});
+}
+size_t CmdlineOptions::color_lut_size() const {
+  return get_uint(*options, COLOR_LUT_SIZE, 2);
+}
 
 size_t CmdlineOptions::analyzer_width_pct() const {
   return get_uint(*options, ANALYZER_WIDTH_PCT, 0, 100);
@@ -197,6 +370,18 @@ size_t CmdlineOptions::analyzer_width_pct() const {
 size_t CmdlineOptions::voiceprint_scroll_rate() const {
   return get_uint(*options, VOICEPRINT_SCROLL_RATE, 1);
 }
+std::string CmdlineOptions::voiceprint_renderer() const {
+  return get_choice(*options, VOICEPRINT_RENDERER, {"pixels", "quads"});
+}
+size_t CmdlineOptions::voiceprint_history_secs() const {
+  return get_uint(*options, VOICEPRINT_HISTORY_SECS, 0);
+}
+size_t CmdlineOptions::scrollback_minutes() const {
+  return get_uint(*options, SCROLLBACK_MINUTES, 0);
+}
+size_t CmdlineOptions::scrollback_mb() const {
+  return get_uint(*options, SCROLLBACK_MB, 0);
+}
 size_t CmdlineOptions::loudness_adjust_rate() const {
   return get_uint(*options, LOUDNESS_ADJUST_RATE, 0);
 }
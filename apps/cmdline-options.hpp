@@ -35,21 +35,39 @@ class CmdlineOptions : public soundview::Options {
   bool list_devices() const;
   std::string device() const;
 
+  std::string state_dir() const;
+
   size_t audio_collect_rate_hz() const;
   size_t audio_sample_rate_hz() const;
 
   size_t display_fps_max() const;
   bool display_vsync() const;
   bool display_fullscreen() const;
+  size_t display_render_scale() const;
+  std::string display_render_filter() const;
 
   size_t bucket_count() const;
   size_t bucket_bass_exaggeration() const;
 
+  std::string fft_engine() const;
+  size_t fft_size() const;
+  size_t fft_hop() const;
+  std::string fft_window() const;
+  std::string fft_precision() const;
+  std::string fft_planner() const;
+  size_t fft_threads() const;
+
   size_t color_lum_exaggeration() const;
   size_t color_max_lum() const;
+  std::string color_palette() const;
+  size_t color_lut_size() const;
 
   size_t analyzer_width_pct() const;
   size_t voiceprint_scroll_rate() const;
+  std::string voiceprint_renderer() const;
+  size_t voiceprint_history_secs() const;
+  size_t scrollback_minutes() const;
+  size_t scrollback_mb() const;
   size_t loudness_adjust_rate() const;
 
  private:
@@ -14,17 +14,24 @@
  * You should have received a copy of the GNU General Public License
  * along with this program.  If not, see <http://www.gnu.org/licenses/>. */
 
+#include <atomic>
+#include <thread>
+
 #include "apps/cmdline-options.hpp"
 #include "soundview/config.hpp"
 #include "soundview/device-selector.hpp"
 #include "soundview/display-runner.hpp"
+#include "soundview/frame-pool.hpp"
+#include "soundview/frame-reducer.hpp"
 #include "soundview/sound-recorder.hpp"
 
 namespace sp = std::placeholders;
 
 namespace {
   /**
-   * Callback handler for reloading devices
+   * Callback handler for reloading devices. Reloads run on a background thread, so that the
+   * display keeps running while devices are being sampled. When the build supports it, the
+   * current device also keeps being recorded until the new one is ready.
    */
   class DeviceReloader {
    public:
@@ -32,7 +39,13 @@ namespace {
       : sample_rate_hz(options.audio_sample_rate_hz()),
         options_device(options.device()),
         recorder(NULL),
-        selector(NULL) { }
+        selector(NULL),
+        reloading(false),
+        cancelled(false) { }
+
+    ~DeviceReloader() {
+      join();
+    }
 
     void set_selector(soundview::DeviceSelector* selector) {
       this->selector = selector;
@@ -42,24 +55,103 @@ namespace {
       this->recorder = recorder;
     }
 
+    void set_display_status(soundview::status_func_t display_status_func) {
+      this->display_status_func = display_status_func;
+    }
+
+    /**
+     * Starts selecting a device in the background, leaving the current device running until the
+     * new one is ready. If a reload is already in progress, cancels it instead.
+     */
     bool reload() {
-      if (recorder == NULL) {
+      if (recorder == NULL || selector == NULL) {
         return false;
       }
-      recorder->stop();
-      bool ret = start();
-      if (!ret) {
-        recorder->start(sample_rate_hz);
+      if (reloading) {
+        LOG("Cancelling device reload");
+        cancelled = true;
+        return false;
       }
-      return ret;
+      // clean up after the previous reload, which has already finished
+      join();
+      cancelled = false;
+      reloading = true;
+      worker = std::thread(&DeviceReloader::run_reload, this);
+      return true;
+    }
+
+    /**
+     * Returns whether a reload is currently in progress.
+     */
+    bool is_reloading() {
+      return reloading;
+    }
+
+    /**
+     * Returns whether device selection should keep going. False once the display has exited or
+     * the reload has been cancelled.
+     */
+    bool check_running() {
+      return !cancelled && (!display_status_func || display_status_func());
     }
 
     bool start() {
       if (recorder == NULL || selector == NULL) {
         return false;
       }
+      std::string device;
+      if (!select_device(device, true)) {
+        return false;
+      }
+      recorder->setDevice(device);
+      return recorder->start(sample_rate_hz);
+    }
+
+    /**
+     * Waits for any reload in progress to finish.
+     */
+    void join() {
+      if (worker.joinable()) {
+        worker.join();
+      }
+    }
 
-      std::string device = options_device;
+   private:
+    void run_reload() {
+      const std::string old_device = recorder->getDevice();
+      // without concurrent sampling, SFML can't sample other devices until the current one stops
+      const bool keep_recording = soundview::DeviceSelector::can_sample_while_recording();
+      if (!keep_recording) {
+        recorder->stop();
+      }
+      std::string device;
+      if (select_device(device, false)) {
+        // the display only accepts frames from one recorder at a time, so the old device is fully
+        // stopped before the new one starts
+        if (keep_recording) {
+          recorder->stop();
+        }
+        recorder->setDevice(device);
+        if (!recorder->start(sample_rate_hz)) {
+          ERROR("Failed to start device %s, returning to %s", device.c_str(), old_device.c_str());
+          recorder->setDevice(old_device);
+          recorder->start(sample_rate_hz);
+        }
+      } else {
+        LOG("No device selected, keeping current device");
+        if (!keep_recording) {
+          recorder->start(sample_rate_hz);
+        }
+      }
+      reloading = false;
+    }
+
+    /**
+     * Picks the device to record. When autoselecting, 'use_cached' tries the last used device
+     * first, which is skipped for reloads since the user wants something different.
+     */
+    bool select_device(std::string& device, bool use_cached) {
+      device = options_device;
       if (!device.empty()) {
         // try to parse specified device as an int index, and map to a device name
         char* invalid_start = NULL;
@@ -73,22 +165,21 @@ namespace {
             LOG("=> Device %lu: %s", (index + 1), device.c_str());
           }
         }
-      } else {
-        // no device specified in args: auto-detect
-        if (!selector->auto_select(device)) {
-          return false;
-        }
+        return true;
       }
-      recorder->setDevice(device);
-
-      return recorder->start(sample_rate_hz);
+      // no device specified in args: auto-detect
+      return (use_cached && selector->select_cached(device)) || selector->auto_select(device);
     }
 
-   private:
     const size_t sample_rate_hz;
     const std::string options_device;
     soundview::SoundRecorder* recorder;
     soundview::DeviceSelector* selector;
+    soundview::status_func_t display_status_func;
+
+    std::thread worker;
+    std::atomic<bool> reloading;
+    std::atomic<bool> cancelled;
   };
 }
 
@@ -96,11 +187,17 @@ int main(int argc, char* argv[]) {
   CmdlineOptions options(argc, argv);
 
   DeviceReloader reloader(options);
+  soundview::FramePool pool(options);
+  soundview::FrameReducer reducer(options);
 
-  soundview::DisplayRunner display_runner(options, std::bind(&::DeviceReloader::reload, &reloader));
+  soundview::DisplayRunner display_runner(
+      options, pool, reducer, std::bind(&::DeviceReloader::reload, &reloader),
+      std::bind(&::DeviceReloader::is_reloading, &reloader));
+  reloader.set_display_status(
+      std::bind(&soundview::DisplayRunner::check_running, &display_runner));
 
   soundview::DeviceSelector selector(
-      std::bind(&soundview::DisplayRunner::check_running, &display_runner));
+      options, std::bind(&::DeviceReloader::check_running, &reloader));
   reloader.set_selector(&selector);
 
   if (options.list_devices()) {
@@ -112,13 +209,17 @@ int main(int argc, char* argv[]) {
     exit(0);
   }
 
-  soundview::SoundRecorder recorder(options,
-      std::bind(&soundview::DisplayRunner::append_freq_data, &display_runner, sp::_1));
+  soundview::SoundRecorder recorder(options, pool, reducer,
+      std::bind(&soundview::DisplayRunner::append_frames, &display_runner, sp::_1));
   reloader.set_recorder(&recorder);
 
   if (reloader.start()) {
     display_runner.run();
     LOG("Exiting.");
+    // a reload may still be sampling devices, and gives up now that the display has exited
+    reloader.join();
+    // the recorder is declared after the display so that it's destroyed first, but stop it here
+    // anyway: the display only returns its leftover frames to the pool once nothing is feeding it
     recorder.stop();
     return 0;
   } else {
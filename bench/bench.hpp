@@ -0,0 +1,69 @@
+/* SoundView - Eye candy for your music
+ * Copyright (C) 2016 Nicholas Parker
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>. */
+
+
+#pragma once
+
+#include <chrono>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "apps/cmdline-options.hpp"
+
+/* Helpers shared by the benchmarks. Each benchmark is a standalone executable which prints its
+ * results as a table. */
+
+namespace bench {
+
+  /**
+   * Calls 'func' repeatedly for at least 'min_secs', after one untimed warmup call. Returns the
+   * average number of nanoseconds per call.
+   */
+  template <typename F>
+  double ns_per_call(F func, double min_secs = 0.25) {
+    typedef std::chrono::steady_clock clock;
+    func();
+    size_t calls = 0;
+    const clock::time_point start = clock::now();
+    std::chrono::duration<double> elapsed;
+    do {
+      func();
+      ++calls;
+      elapsed = clock::now() - start;
+    } while (elapsed.count() < min_secs);
+    return elapsed.count() * 1e9 / calls;
+  }
+
+  /**
+   * Returns options parsed from 'args', followed by any args which were passed to the benchmark.
+   * This lets the benchmarks use the same defaults as the app, while options which they don't
+   * vary (eg --planner or --state-dir) may be passed through.
+   */
+  inline std::unique_ptr<CmdlineOptions> options(int argc, char* argv[],
+      const std::vector<std::string>& args) {
+    std::vector<std::string> all(1, argv[0]);
+    all.insert(all.end(), args.begin(), args.end());
+    all.insert(all.end(), argv + 1, argv + argc);
+    std::vector<char*> ptrs;
+    for (std::string& arg : all) {
+      ptrs.push_back(&arg[0]);
+    }
+    int parse_argc = ptrs.size();
+    return std::unique_ptr<CmdlineOptions>(new CmdlineOptions(parse_argc, ptrs.data()));
+  }
+
+}
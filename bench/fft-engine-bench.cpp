@@ -0,0 +1,130 @@
+/* SoundView - Eye candy for your music
+ * Copyright (C) 2016 Nicholas Parker
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>. */
+
+
+#include <math.h>
+#include <stdio.h>
+#include <algorithm>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "bench/bench.hpp"
+#include "soundview/aligned-allocator.hpp"
+#include "soundview/config.hpp"
+#include "soundview/fft-engine.hpp"
+
+/* Compares the FFT engines picked by --fft-engine across FFT lengths, timing what the transformer
+ * does with each frame: converting the samples, running the FFT, and taking the magnitudes. Any
+ * other app flags (eg --planner) are applied to every run. */
+
+namespace {
+  struct Result {
+    double ns_per_frame;
+    std::vector<soundview::freq_t> magnitudes;
+  };
+
+  /**
+   * 'len' samples of a few tones over some noise.
+   */
+  std::vector<int16_t> make_audio(size_t len) {
+    std::vector<int16_t> audio(len);
+    std::mt19937 rng(1);
+    std::normal_distribution<double> noise(0, 300);
+    for (size_t i = 0; i < len; ++i) {
+      audio[i] = 8000 * sin(2 * M_PI * 37.2 * i / len)
+        + 4000 * sin(2 * M_PI * 301.7 * i / len) + noise(rng);
+    }
+    return audio;
+  }
+
+  template <typename T>
+  Result run(const soundview::Options& options, const std::vector<int16_t>& audio) {
+    const size_t len = audio.size();
+    const size_t bin_count = len / 2 + 1;
+    soundview::aligned_vector<T> in(len);
+    soundview::aligned_vector<typename soundview::FftComplex<T>::type> out(bin_count);
+    Result result;
+    result.magnitudes.resize(bin_count);
+
+    soundview::FftBuffers<T> buffers;
+    buffers.len = len;
+    buffers.frames = 1;
+    buffers.in = in.data();
+    buffers.in_dist = len;
+    buffers.out = out.data();
+    buffers.out_dist = bin_count;
+    std::unique_ptr<soundview::FftEngine<T>> engine(soundview::new_fft_engine(options, buffers));
+
+    result.ns_per_frame = bench::ns_per_call([&]() {
+      soundview::simd_pcm_to_fft(audio.data(), len, in.data());
+      engine->transform(1);
+      soundview::simd_magnitudes(out.data(), bin_count, result.magnitudes.data());
+    });
+    return result;
+  }
+
+  /**
+   * Returns the largest difference from the reference, after scaling each to its loudest value.
+   * The engines don't all scale their output the same way, but the spectrum should have the same
+   * shape.
+   */
+  double max_relative_diff(const std::vector<soundview::freq_t>& vals,
+      const std::vector<soundview::freq_t>& ref) {
+    const double max_val = *std::max_element(vals.begin(), vals.end());
+    const double max_ref = *std::max_element(ref.begin(), ref.end());
+    if (max_val == 0 || max_ref == 0) {
+      return (max_val == max_ref) ? 0 : 1;
+    }
+    double max_diff = 0;
+    for (size_t i = 0; i < std::min(vals.size(), ref.size()); ++i) {
+      max_diff = std::max(max_diff, fabs(vals[i] / max_val - ref[i] / max_ref));
+    }
+    return max_diff;
+  }
+
+  void print(const char* engine, const char* precision, size_t len,
+      const Result& result, const Result& ref) {
+    printf("%8s %7s %8lu %12.2f %14.2e\n", engine, precision, len,
+        result.ns_per_frame / 1000, max_relative_diff(result.magnitudes, ref.magnitudes));
+  }
+}
+
+int main(int argc, char* argv[]) {
+  // powers of two, which every engine supports
+  const size_t fft_lens[] = {512, 2048, 8192, 32768, 131072};
+
+  printf("%8s %7s %8s %12s %14s\n", "engine", "bits", "fft len", "us/frame", "diff vs ref");
+  for (size_t len : fft_lens) {
+    const std::vector<int16_t> audio = make_audio(len);
+    std::unique_ptr<CmdlineOptions> builtin =
+      bench::options(argc, argv, {"--fft-engine", "builtin"});
+    // builtin double is the reference, since it's available in every build
+    const Result ref = run<double>(*builtin, audio);
+    print("builtin", "64", len, ref, ref);
+    print("builtin", "32", len, run<float>(*builtin, audio), ref);
+#ifdef SOUNDVIEW_FFTW
+    std::unique_ptr<CmdlineOptions> fftw = bench::options(argc, argv, {"--fft-engine", "fftw"});
+    print("fftw", "64", len, run<double>(*fftw, audio), ref);
+#ifdef SOUNDVIEW_FFTW_FLOAT
+    print("fftw", "32", len, run<float>(*fftw, audio), ref);
+#endif
+#endif
+    std::unique_ptr<CmdlineOptions> q15 = bench::options(argc, argv, {"--fft-engine", "q15"});
+    print("q15", "16", len, run<int16_t>(*q15, audio), ref);
+  }
+  return 0;
+}
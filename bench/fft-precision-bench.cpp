@@ -0,0 +1,134 @@
+/* SoundView - Eye candy for your music
+ * Copyright (C) 2016 Nicholas Parker
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>. */
+
+
+#include <math.h>
+#include <stdio.h>
+#include <algorithm>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "bench/bench.hpp"
+#include "soundview/frame-pool.hpp"
+#include "soundview/frame-reducer.hpp"
+#include "soundview/transformer-buffer.hpp"
+
+/* Compares the float and double FFT pipelines at large bucket counts, by streaming the same audio
+ * through a TransformerBuffer of each precision. Any app flags (eg --fft-engine, --hop or
+ * --planner) are applied to every run. */
+
+namespace {
+  struct Result {
+    double ns_per_frame;
+    // the first frame produced, which covers the same audio for both precisions
+    std::vector<soundview::freq_t> first;
+  };
+
+  /**
+   * A second of tones over some noise, at the configured sample rate.
+   */
+  std::vector<int16_t> make_audio(size_t sample_rate_hz) {
+    std::vector<int16_t> audio(sample_rate_hz);
+    std::mt19937 rng(1);
+    std::normal_distribution<double> noise(0, 300);
+    for (size_t i = 0; i < audio.size(); ++i) {
+      const double t = (double)i / sample_rate_hz;
+      audio[i] = 8000 * sin(2 * M_PI * 440 * t) + 4000 * sin(2 * M_PI * 3520 * t) + noise(rng);
+    }
+    return audio;
+  }
+
+  template <typename T>
+  Result run(const soundview::Options& options, const std::vector<int16_t>& audio) {
+    soundview::FramePool pool(options);
+    soundview::FrameReducer reducer(options);
+    Result result;
+    size_t frames = 0;
+    soundview::TransformerBuffer<T> transformer(options, pool, reducer,
+        [&](const std::vector<soundview::Frame*>& out) {
+          if (frames == 0 && result.first.empty()) {
+            result.first.assign(out[0]->data, out[0]->data + out[0]->len);
+          }
+          frames += out.size();
+          for (soundview::Frame* f : out) {
+            pool.release(f);
+          }
+        });
+
+    // same chunk sizes as the device would deliver
+    const size_t chunk = std::max<size_t>(1,
+        options.audio_sample_rate_hz() / options.audio_collect_rate_hz());
+    size_t pos = 0;
+    auto add_chunk = [&]() {
+      if (pos + chunk > audio.size()) {
+        pos = 0;
+      }
+      transformer.add(audio.data() + pos, chunk, soundview::frame_clock_t::now());
+      pos += chunk;
+    };
+    // fill the transformer's window before timing anything, so that every chunk produces frames
+    while (frames == 0) {
+      add_chunk();
+    }
+    frames = 0;
+    size_t chunks = 0;
+    const double ns_per_chunk = bench::ns_per_call([&]() {
+      add_chunk();
+      ++chunks;
+    });
+    // ns_per_call() makes one untimed warmup call, whose frames are included in 'frames'
+    result.ns_per_frame = ns_per_chunk * chunks / std::max<size_t>(1, frames);
+    return result;
+  }
+
+  /**
+   * Returns the largest difference between the two frames, relative to the loudest value.
+   */
+  double max_relative_diff(const std::vector<soundview::freq_t>& a,
+      const std::vector<soundview::freq_t>& b) {
+    double max_diff = 0, max_val = 0;
+    for (size_t i = 0; i < std::min(a.size(), b.size()); ++i) {
+      max_diff = std::max(max_diff, fabs((double)a[i] - b[i]));
+      max_val = std::max(max_val, (double)b[i]);
+    }
+    return (max_val == 0) ? 0 : max_diff / max_val;
+  }
+}
+
+int main(int argc, char* argv[]) {
+  const size_t bucket_counts[] = {4096, 8192, 16384, 32768, 65536};
+
+  printf("%8s %14s %14s %8s %14s\n",
+      "buckets", "double us/frm", "float us/frm", "speedup", "max rel diff");
+  for (size_t buckets : bucket_counts) {
+    std::unique_ptr<CmdlineOptions> options =
+      bench::options(argc, argv, {"--buckets", std::to_string(buckets)});
+    const std::vector<int16_t> audio = make_audio(options->audio_sample_rate_hz());
+#if defined(SOUNDVIEW_FFTW) && !defined(SOUNDVIEW_FFTW_FLOAT)
+    if (options->fft_engine() == "fftw") {
+      printf("%8lu (float FFTW support wasn't included in this build)\n", buckets);
+      continue;
+    }
+#endif
+    const Result d = run<double>(*options, audio);
+    const Result f = run<float>(*options, audio);
+    printf("%8lu %14.1f %14.1f %7.2fx %14.2e\n", buckets,
+        d.ns_per_frame / 1000, f.ns_per_frame / 1000, d.ns_per_frame / f.ns_per_frame,
+        max_relative_diff(f.first, d.first));
+  }
+  return 0;
+}
@@ -0,0 +1,195 @@
+/* SoundView - Eye candy for your music
+ * Copyright (C) 2016 Nicholas Parker
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>. */
+
+
+#include <stdio.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "bench/bench.hpp"
+#include "soundview/frame-pool.hpp"
+#include "soundview/spsc-queue.hpp"
+
+/* Compares how long the audio thread spends handing a frame to the display, between the lock-free
+ * FramePool + SpscQueue used now and the mutex-guarded DoubleBuffer of vectors used before. The
+ * display thread takes whatever has arrived, then waits a while as if drawing it. App flags such as
+ * --buckets are used for the frame size and pool size. */
+
+namespace {
+  typedef std::chrono::steady_clock clock;
+
+  const size_t FRAME_COUNT = 100000;
+
+  /**
+   * The previous design: the audio thread appends a copy of each frame to one vector under a
+   * mutex, while the display thread swaps it for the other vector under the same mutex.
+   */
+  class MutexDoubleBuffer {
+   public:
+    MutexDoubleBuffer() : buf_in(&buf_a) { }
+
+    bool append(const soundview::freq_t* data, size_t len) {
+      std::unique_lock<std::mutex> lock(mutex);
+      buf_in->push_back(std::vector<soundview::freq_t>(data, data + len));
+      return true;
+    }
+
+    size_t consume() {
+      std::vector<std::vector<soundview::freq_t>>* out;
+      {
+        std::unique_lock<std::mutex> lock(mutex);
+        out = (buf_in == &buf_a) ? &buf_b : &buf_a;
+        if (out->empty()) {
+          // swap, so that the display reads what the audio thread has been writing
+          out = buf_in;
+          buf_in = (buf_in == &buf_a) ? &buf_b : &buf_a;
+        }
+      }
+      // drawn outside of the lock, while the audio thread appends to the other buffer
+      const size_t count = out->size();
+      out->clear();
+      return count;
+    }
+
+   private:
+    std::mutex mutex;
+    std::vector<std::vector<soundview::freq_t>> buf_a, buf_b;
+    std::vector<std::vector<soundview::freq_t>>* buf_in;
+  };
+
+  /**
+   * The current design: the audio thread fills a frame from the pool in place and queues a pointer
+   * to it, and the display thread returns frames to the pool once they're drawn.
+   */
+  class PoolQueue {
+   public:
+    PoolQueue(const soundview::Options& options)
+      : pool(options), queue(pool.size()) {
+      drawn.reserve(pool.size());
+    }
+
+    bool append(const soundview::freq_t* data, size_t len) {
+      soundview::Frame* frame = pool.acquire();
+      if (frame == NULL) {
+        return false;
+      }
+      std::copy(data, data + len, frame->data);
+      frame->len = len;
+      queue.push(frame);
+      return true;
+    }
+
+    size_t consume() {
+      soundview::Frame* frame;
+      while (queue.pop(frame)) {
+        drawn.push_back(frame);
+      }
+      const size_t count = drawn.size();
+      for (soundview::Frame* f : drawn) {
+        pool.release(f);
+      }
+      drawn.clear();
+      return count;
+    }
+
+   private:
+    soundview::FramePool pool;
+    soundview::SpscQueue<soundview::Frame*> queue;
+    std::vector<soundview::Frame*> drawn;
+  };
+
+  /**
+   * Sends FRAME_COUNT frames from a producer thread, one every 'period', while the consumer
+   * repeatedly takes what's arrived and then sleeps for 'draw' as if waiting on the display. Prints
+   * the time taken by each append, along with how many frames were dropped.
+   */
+  template <typename Queue>
+  void run(const char* name, Queue& queue, size_t frame_len,
+      std::chrono::microseconds period, std::chrono::microseconds draw) {
+    std::vector<soundview::freq_t> data(frame_len, 1);
+    std::vector<double> append_ns(FRAME_COUNT);
+    std::atomic<bool> done(false);
+    size_t consumed = 0;
+
+    std::thread consumer([&]() {
+      while (!done.load(std::memory_order_acquire)) {
+        consumed += queue.consume();
+        if (draw.count() == 0) {
+          std::this_thread::yield();
+        } else {
+          std::this_thread::sleep_for(draw);
+        }
+      }
+      consumed += queue.consume();
+    });
+
+    size_t dropped = 0;
+    const clock::time_point start = clock::now();
+    clock::time_point next = start;
+    for (size_t i = 0; i < FRAME_COUNT; ++i) {
+      if (period.count() != 0) {
+        std::this_thread::sleep_until(next);
+        next += period;
+      }
+      const clock::time_point before = clock::now();
+      if (!queue.append(data.data(), frame_len)) {
+        ++dropped;
+      }
+      append_ns[i] = std::chrono::duration<double, std::nano>(clock::now() - before).count();
+    }
+    const double secs = std::chrono::duration<double>(clock::now() - start).count();
+    done.store(true, std::memory_order_release);
+    consumer.join();
+
+    std::sort(append_ns.begin(), append_ns.end());
+    printf("%-8s %6ld %6ld %10.0f %10.0f %10.0f %12.0f %8lu %8lu\n", name,
+        (long)period.count(), (long)draw.count(),
+        append_ns[FRAME_COUNT / 2], append_ns[FRAME_COUNT * 99 / 100], append_ns.back(),
+        FRAME_COUNT / secs, dropped, consumed);
+  }
+}
+
+int main(int argc, char* argv[]) {
+  std::unique_ptr<CmdlineOptions> options = bench::options(argc, argv, {});
+  const size_t frame_len = options->bucket_count();
+
+  // unpaced with an instant display is the most contention on the hand-off itself. pacing the
+  // frames and drawing for a few ms is closer to the app, where a slow draw shouldn't hold up
+  // audio. unpaced spsc is expected to drop frames once the fixed pool runs out
+  const std::chrono::microseconds periods[] = {
+    std::chrono::microseconds(0), std::chrono::microseconds(100), std::chrono::microseconds(100)};
+  const std::chrono::microseconds draws[] = {
+    std::chrono::microseconds(0), std::chrono::microseconds(0), std::chrono::microseconds(4000)};
+
+  printf("%lu frames of %lu values, append times in ns\n", FRAME_COUNT, frame_len);
+  printf("%-8s %6s %6s %10s %10s %10s %12s %8s %8s\n",
+      "design", "per us", "draw", "p50", "p99", "max", "frames/s", "dropped", "drawn");
+  for (size_t i = 0; i < sizeof(periods) / sizeof(periods[0]); ++i) {
+    {
+      MutexDoubleBuffer queue;
+      run("mutex", queue, frame_len, periods[i], draws[i]);
+    }
+    {
+      PoolQueue queue(*options);
+      run("spsc", queue, frame_len, periods[i], draws[i]);
+    }
+  }
+  return 0;
+}
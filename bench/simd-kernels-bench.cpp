@@ -0,0 +1,136 @@
+/* SoundView - Eye candy for your music
+ * Copyright (C) 2016 Nicholas Parker
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>. */
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <random>
+#include <vector>
+
+#include "bench/bench.hpp"
+#include "soundview/aligned-allocator.hpp"
+#include "soundview/simd-kernels-impl.hpp"
+
+/* Times each DSP kernel with every set of kernels which this CPU can run, on one frame's worth of
+ * values. Usage: simd-kernels-bench [len], where len defaults to the default bucket count. */
+
+namespace {
+  struct Inputs {
+    Inputs(size_t len)
+      : pcm(len), cfloat(len), cdouble(len), q15(2 * len), values(len),
+        out_float(len), out_double(len), out_levels(len) {
+      std::mt19937 rng(1);
+      std::uniform_int_distribution<int> pcm_dist(-32768, 32767);
+      std::uniform_real_distribution<double> val_dist(0, 1e3);
+      for (size_t i = 0; i < len; ++i) {
+        pcm[i] = pcm_dist(rng);
+        q15[2 * i] = pcm_dist(rng);
+        q15[2 * i + 1] = pcm_dist(rng);
+        cfloat[i] = std::complex<float>(val_dist(rng), val_dist(rng));
+        cdouble[i] = std::complex<double>(val_dist(rng), val_dist(rng));
+        values[i] = val_dist(rng);
+      }
+    }
+
+    soundview::aligned_vector<int16_t> pcm;
+    soundview::aligned_vector<std::complex<float>> cfloat;
+    soundview::aligned_vector<std::complex<double>> cdouble;
+    soundview::aligned_vector<int16_t> q15;
+    soundview::aligned_vector<soundview::freq_t> values;
+    soundview::aligned_vector<float> out_float;
+    soundview::aligned_vector<double> out_double;
+    soundview::aligned_vector<uint8_t> out_levels;
+  };
+
+  // result of each kernel is kept here so that it can't be optimized away
+  volatile double sink = 0;
+
+  /**
+   * Returns the nanoseconds per call of each kernel, in the order they're printed.
+   */
+  std::vector<double> run(const soundview::SimdKernels& k, Inputs& in) {
+    const size_t len = in.pcm.size();
+    std::vector<double> ret;
+    ret.push_back(bench::ns_per_call([&]() {
+      k.pcm_to_float(in.pcm.data(), len, in.out_float.data());
+    }));
+    ret.push_back(bench::ns_per_call([&]() {
+      k.pcm_to_double(in.pcm.data(), len, in.out_double.data());
+    }));
+    ret.push_back(bench::ns_per_call([&]() {
+      k.magnitudes_float(in.cfloat.data(), len, in.out_float.data());
+    }));
+    ret.push_back(bench::ns_per_call([&]() {
+      k.magnitudes_double(in.cdouble.data(), len, in.out_float.data());
+    }));
+    ret.push_back(bench::ns_per_call([&]() {
+      k.magnitudes_q15(in.q15.data(), len, in.out_float.data());
+    }));
+    ret.push_back(bench::ns_per_call([&]() {
+      sink = k.abs_sum(in.pcm.data(), len);
+    }));
+    ret.push_back(bench::ns_per_call([&]() {
+      sink = k.max_value(in.values.data(), len, 0);
+    }));
+    ret.push_back(bench::ns_per_call([&]() {
+      k.quantize(in.values.data(), len, 0.255f, in.out_levels.data());
+    }));
+    return ret;
+  }
+}
+
+int main(int argc, char* argv[]) {
+  const size_t len = (argc > 1) ? strtoul(argv[1], NULL, 10) : 4096;
+  const char* names[] = {
+    "pcm_to_float", "pcm_to_double", "magnitudes_float", "magnitudes_double",
+    "magnitudes_q15", "abs_sum", "max_value", "quantize"};
+
+  std::vector<const soundview::SimdKernels*> kernels(1, &soundview::scalar_kernels());
+#ifdef SOUNDVIEW_SIMD_X86
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("sse2")) {
+    kernels.push_back(&soundview::sse2_kernels());
+  }
+  if (__builtin_cpu_supports("avx2")) {
+    kernels.push_back(&soundview::avx2_kernels());
+  }
+  if (__builtin_cpu_supports("avx512f")) {
+    kernels.push_back(&soundview::avx512_kernels());
+  }
+#endif
+
+  Inputs in(len);
+  std::vector<std::vector<double>> results;
+  for (const soundview::SimdKernels* k : kernels) {
+    results.push_back(run(*k, in));
+  }
+
+  printf("ns per call with len=%lu (speedup over scalar)\n", len);
+  printf("%-18s", "kernel");
+  for (const soundview::SimdKernels* k : kernels) {
+    printf(" %18s", k->name);
+  }
+  printf("\n");
+  for (size_t i = 0; i < sizeof(names) / sizeof(names[0]); ++i) {
+    printf("%-18s", names[i]);
+    for (size_t k = 0; k < kernels.size(); ++k) {
+      printf(" %10.1f (%4.1fx)", results[k][i], results[0][i] / results[k][i]);
+    }
+    printf("\n");
+  }
+  printf("selected at runtime: %s\n", soundview::simd_kernels().name);
+  return 0;
+}
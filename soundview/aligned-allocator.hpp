@@ -0,0 +1,108 @@
+/* SoundView - Eye candy for your music
+ * Copyright (C) 2016 Nicholas Parker
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>. */
+
+
+#pragma once
+
+#include <stddef.h>
+#include <stdlib.h>
+#include <new>
+#include <vector>
+
+#ifdef WIN32
+#include <malloc.h>
+#endif
+
+namespace soundview {
+
+  /**
+   * Alignment of the buffers used by the FFT and the SIMD kernels: enough for AVX-512 loads, and
+   * for each buffer to start on its own cache line. This is at least as strict as what FFTW
+   * needs to use its SIMD codelets.
+   */
+  const size_t BUFFER_ALIGNMENT = 64;
+
+  /**
+   * Rounds up a number of elements to a multiple of BUFFER_ALIGNMENT bytes. Arrays which are
+   * packed end to end at this stride keep the alignment of the first.
+   */
+  template <typename T>
+  size_t aligned_len(size_t len) {
+    const size_t elems_per_line = BUFFER_ALIGNMENT / sizeof(T);
+    return ((len + elems_per_line - 1) / elems_per_line) * elems_per_line;
+  }
+
+  /**
+   * An allocator which returns memory aligned to BUFFER_ALIGNMENT, for use with std::vector.
+   */
+  template <typename T>
+  class AlignedAllocator {
+   public:
+    typedef T value_type;
+
+    template <typename U>
+    struct rebind {
+      typedef AlignedAllocator<U> other;
+    };
+
+    AlignedAllocator() { }
+    template <typename U>
+    AlignedAllocator(const AlignedAllocator<U>&) { }
+
+    T* allocate(size_t n) {
+      if (n == 0) {
+        return NULL;
+      }
+      void* ptr;
+#ifdef WIN32
+      ptr = _aligned_malloc(n * sizeof(T), BUFFER_ALIGNMENT);
+#else
+      if (posix_memalign(&ptr, BUFFER_ALIGNMENT, n * sizeof(T)) != 0) {
+        ptr = NULL;
+      }
+#endif
+      if (ptr == NULL) {
+        throw std::bad_alloc();
+      }
+      return static_cast<T*>(ptr);
+    }
+
+    void deallocate(T* ptr, size_t) {
+#ifdef WIN32
+      _aligned_free(ptr);
+#else
+      free(ptr);
+#endif
+    }
+  };
+
+  template <typename T, typename U>
+  bool operator==(const AlignedAllocator<T>&, const AlignedAllocator<U>&) {
+    return true;
+  }
+
+  template <typename T, typename U>
+  bool operator!=(const AlignedAllocator<T>&, const AlignedAllocator<U>&) {
+    return false;
+  }
+
+  /**
+   * A vector whose data() is aligned to BUFFER_ALIGNMENT.
+   */
+  template <typename T>
+  using aligned_vector = std::vector<T, AlignedAllocator<T>>;
+
+}
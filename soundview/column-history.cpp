@@ -0,0 +1,31 @@
+/* SoundView - Eye candy for your music
+ * Copyright (C) 2016 Nicholas Parker
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>. */
+
+
+#include <algorithm>
+
+#include "soundview/column-history.hpp"
+#include "soundview/config.hpp"
+
+soundview::ColumnHistory::ColumnHistory(const Options& options)
+  : column_len(aligned_len<uint8_t>(options.bucket_count())),
+    // the scheduler produces display_fps_max() columns per second
+    capacity(options.voiceprint_history_secs() * options.display_fps_max()),
+    levels(std::max<size_t>(capacity, 1) * column_len, 0),
+    next(0),
+    count(0) {
+  DEBUG("Voiceprint history: %lu columns, %lu bytes", capacity, levels.size());
+}
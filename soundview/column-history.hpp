@@ -0,0 +1,81 @@
+/* SoundView - Eye candy for your music
+ * Copyright (C) 2016 Nicholas Parker
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>. */
+
+
+#pragma once
+
+#include <stdint.h>
+#include <vector>
+
+#include "soundview/aligned-allocator.hpp"
+#include "soundview/options.hpp"
+
+namespace soundview {
+
+  /**
+   * A bounded ring of the most recent voiceprint columns, kept independently of any texture so
+   * that the voiceprint can be redrawn after the window is resized or rotated.
+   *
+   * Each column holds one level per bucket, quantized to 8 bits relative to the loudness at the
+   * time it was drawn. This is all that's needed to reproduce its colors, at a quarter of the
+   * memory of keeping RGBA pixels.
+   */
+  class ColumnHistory {
+   public:
+    ColumnHistory(const Options& options);
+
+    /**
+     * Returns storage for bucket_count() levels in a new column, replacing the oldest column if the
+     * history is full. The storage is valid until the next call to push().
+     */
+    uint8_t* push() {
+      uint8_t* column = levels.data() + (next * column_len);
+      if (capacity > 0) {
+        next = (next + 1) % capacity;
+        if (count < capacity) {
+          ++count;
+        }
+      }
+      return column;
+    }
+
+    /**
+     * Returns the column which was pushed 'age' columns ago, where 0 is the newest column.
+     * 'age' must be less than size().
+     */
+    const uint8_t* get(size_t age) const {
+      return levels.data() + (((next + capacity - 1 - age) % capacity) * column_len);
+    }
+
+    /**
+     * Returns the number of columns currently in the history.
+     */
+    size_t size() const {
+      return count;
+    }
+
+   private:
+    // distance between columns in levels, padded so that every column is aligned for the SIMD
+    // kernels
+    const size_t column_len;
+    const size_t capacity;
+    // always has room for at least one column, for push() to return when the history is disabled
+    aligned_vector<uint8_t> levels;
+    size_t next;
+    size_t count;
+  };
+
+}
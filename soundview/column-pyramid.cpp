@@ -0,0 +1,138 @@
+/* SoundView - Eye candy for your music
+ * Copyright (C) 2016 Nicholas Parker
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>. */
+
+
+#include <algorithm>
+
+#include "soundview/column-pyramid.hpp"
+#include "soundview/config.hpp"
+
+namespace {
+  const size_t MAX_LEVELS = 32;
+  // columns to allocate for a level when its first column is added. it then doubles as needed
+  const size_t MIN_LEVEL_ALLOC = 64;
+}
+
+soundview::ColumnPyramid::ColumnPyramid(const Options& options)
+  : column_len(options.bucket_count()),
+    capacity(0),
+    prev_column(column_len, 0),
+    prev_half(false) {
+  // the number of original columns to cover, at display_fps_max() columns per second
+  const size_t wanted = options.scrollback_minutes() * 60 * options.display_fps_max();
+  const size_t total = options.scrollback_mb() * 1024 * 1024 / (STAT_COUNT * column_len);
+  if (wanted == 0) {
+    return;
+  }
+  // find the fewest levels where each level has enough columns for the top one to cover 'wanted'
+  size_t level_count = 1;
+  for (; level_count < MAX_LEVELS; ++level_count) {
+    if ((total / level_count) << level_count >= wanted) {
+      break;
+    }
+  }
+  capacity = total / level_count;
+  if (capacity < 2) {
+    ERROR("Scrollback of %lu minutes doesn't fit in %luMB, disabling scrollback",
+        options.scrollback_minutes(), options.scrollback_mb());
+    capacity = 0;
+    return;
+  }
+  levels.resize(level_count);
+  for (Level& level : levels) {
+    level.next = 0;
+    level.count = 0;
+    level.half = false;
+  }
+  DEBUG("Scrollback: %lu levels of %lu columns, covering %lu columns in up to %luMB",
+      level_count, capacity, capacity << level_count,
+      (level_count * capacity * STAT_COUNT * column_len) / (1024 * 1024));
+}
+
+void soundview::ColumnPyramid::add(const uint8_t* column) {
+  if (levels.empty()) {
+    return;
+  }
+  if (!prev_half) {
+    std::copy(column, column + column_len, prev_column.begin());
+    prev_half = true;
+    return;
+  }
+  prev_half = false;
+
+  // summarize this column and the previous one into level 1
+  uint8_t* out = push(levels[0]);
+  uint8_t* out_max = out + (STAT_MAX * column_len);
+  uint8_t* out_mean = out + (STAT_MEAN * column_len);
+  uint8_t* out_min = out + (STAT_MIN * column_len);
+  for (size_t i = 0; i < column_len; ++i) {
+    const uint8_t a = prev_column[i], b = column[i];
+    out_max[i] = std::max(a, b);
+    out_mean[i] = (a + b + 1) / 2;
+    out_min[i] = std::min(a, b);
+  }
+  add_level(1);
+}
+
+uint8_t* soundview::ColumnPyramid::push(Level& level) {
+  const size_t column_size = STAT_COUNT * column_len;
+  if ((level.next + 1) * column_size > level.data.size()) {
+    // still filling the level for the first time. double its allocation, up to the full ring.
+    // reserve() first so that the vector doesn't round the allocation up past the ring
+    const size_t columns = std::min(capacity,
+        std::max(MIN_LEVEL_ALLOC, 2 * level.data.size() / column_size));
+    level.data.reserve(columns * column_size);
+    level.data.resize(columns * column_size);
+  }
+  uint8_t* column = level.data.data() + (level.next * column_size);
+  level.next = (level.next + 1) % capacity;
+  if (level.count < capacity) {
+    ++level.count;
+  }
+  return column;
+}
+
+void soundview::ColumnPyramid::add_level(size_t level) {
+  // a column was just added to 'level': summarize it into the level above on every other call
+  for (; level < levels.size(); ++level) {
+    Level& above = levels[level];
+    if (!above.half) {
+      above.half = true;
+      return;
+    }
+    above.half = false;
+
+    uint8_t* out = push(above);
+    const uint8_t* newer = get(level, 0, STAT_MAX);
+    const uint8_t* older = get(level, 1, STAT_MAX);
+    for (size_t i = 0; i < column_len; ++i) {
+      out[i] = std::max(newer[i], older[i]);
+    }
+    out += column_len;
+    newer += column_len;
+    older += column_len;
+    for (size_t i = 0; i < column_len; ++i) {
+      // both cover the same number of original columns, so the mean is their mean
+      out[i] = (newer[i] + older[i] + 1) / 2;
+    }
+    out += column_len;
+    newer += column_len;
+    older += column_len;
+    for (size_t i = 0; i < column_len; ++i) {
+      out[i] = std::min(newer[i], older[i]);
+    }
+  }
+}
@@ -0,0 +1,102 @@
+/* SoundView - Eye candy for your music
+ * Copyright (C) 2016 Nicholas Parker
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>. */
+
+
+#pragma once
+
+#include <stdint.h>
+#include <vector>
+
+#include "soundview/options.hpp"
+
+namespace soundview {
+
+  /**
+   * A level-of-detail pyramid of past voiceprint columns, for scrolling back further than the
+   * ColumnHistory goes. Level 1 summarizes pairs of the original columns, level 2 summarizes pairs
+   * of level 1 columns, and so on, so that a zoomed-out view can be drawn from a level which has
+   * about one column per pixel, regardless of how much time it covers.
+   *
+   * Each summarized column holds the min, max, and mean level of each bucket. Levels are built
+   * incrementally as columns are added, and each level is a ring holding the same number of
+   * columns. The number of levels and columns per level are sized to cover scrollback_minutes()
+   * within scrollback_mb(). Each ring is only allocated as its level fills up, so memory use grows
+   * towards scrollback_mb() as audio arrives, rather than all of it being taken at startup.
+   */
+  class ColumnPyramid {
+   public:
+    enum Stat {
+      STAT_MAX = 0,
+      STAT_MEAN,
+      STAT_MIN,
+      STAT_COUNT
+    };
+
+    ColumnPyramid(const Options& options);
+
+    /**
+     * Adds a column of bucket_count() levels at the original resolution.
+     */
+    void add(const uint8_t* column);
+
+    /**
+     * Returns the number of summarized levels, not counting the original columns. Levels are
+     * numbered from 1 to level_count(). Returns 0 if the pyramid is disabled.
+     */
+    size_t level_count() const {
+      return levels.size();
+    }
+
+    /**
+     * Returns the number of columns currently in 'level'.
+     */
+    size_t size(size_t level) const {
+      return levels[level - 1].count;
+    }
+
+    /**
+     * Returns the 'stat' of each bucket in the column of 'level' which was added 'age' columns ago,
+     * where 0 is the newest column. 'age' must be less than size(level).
+     */
+    const uint8_t* get(size_t level, size_t age, Stat stat) const {
+      const Level& l = levels[level - 1];
+      const size_t col = (l.next + capacity - 1 - age) % capacity;
+      return l.data.data() + (col * STAT_COUNT + stat) * column_len;
+    }
+
+   private:
+    struct Level {
+      // up to 'capacity' columns, each holding STAT_COUNT sets of column_len values. grows until
+      // the level is full, after which it's used as a ring
+      std::vector<uint8_t> data;
+      size_t next;
+      size_t count;
+      // whether a column has been added to the level below since this level was last updated
+      bool half;
+    };
+
+    uint8_t* push(Level& level);
+    void add_level(size_t level);
+
+    const size_t column_len;
+    size_t capacity;
+    std::vector<Level> levels;
+    // the previous original column, to be summarized into level 1 along with the next one
+    std::vector<uint8_t> prev_column;
+    bool prev_half;
+  };
+
+}
@@ -18,6 +18,14 @@
 
 #include <stdio.h>
 
+/* optional build features */
+
+#cmakedefine SOUNDVIEW_FFTW
+#cmakedefine SOUNDVIEW_FFTW_FLOAT
+#cmakedefine SOUNDVIEW_FFTW_THREADS
+#cmakedefine SOUNDVIEW_OPENAL_PROBE
+#cmakedefine SOUNDVIEW_SIMD_X86
+
 /* winders hax */
 
 #ifdef WIN32
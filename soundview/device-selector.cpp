@@ -14,8 +14,17 @@
  * You should have received a copy of the GNU General Public License
  * along with this program.  If not, see <http://www.gnu.org/licenses/>. */
 
+#include <stdint.h>
+#include <stdlib.h>
+#include <time.h>
+#include <algorithm>
+#include <chrono>
 #include <condition_variable>
+#include <fstream>
+#include <mutex>
 #include <sstream>
+#include <thread>
+#include <vector>
 
 #ifdef WIN32
 // think different
@@ -30,6 +39,18 @@
 
 #include "soundview/config.hpp"
 #include "soundview/device-selector.hpp"
+#include "soundview/simd-kernels.hpp"
+#include "soundview/state-file.hpp"
+
+#ifdef SOUNDVIEW_OPENAL_PROBE
+#ifdef __APPLE__
+#include <OpenAL/al.h>
+#include <OpenAL/alc.h>
+#else
+#include <AL/al.h>
+#include <AL/alc.h>
+#endif
+#endif
 
 namespace {
 
@@ -37,6 +58,109 @@ namespace {
   const static size_t SAMPLE_COUNT = 1000;
   // period at which sfml sends samples to us
   const static double SECS_PER_ROUND = 0.01;
+  // how long to spend sampling devices before going with what we have
+  const static std::chrono::milliseconds PROBE_DEADLINE(2000);
+  // how long to wait for the last used device to produce some audio before sampling all devices
+  const static std::chrono::milliseconds CACHED_DEVICE_WINDOW(1000);
+  // file within the state dir where the last autoselected device is kept
+  const static char* CACHE_FILE_NAME = "last-device";
+  // a device whose samples average at least this amplitude is clearly active, so there's no need
+  // to keep sampling the others (roughly -30dB)
+  const static size_t ACTIVE_AMPLITUDE = 1000;
+
+  typedef std::chrono::steady_clock probe_clock_t;
+
+  /**
+   * State shared between the devices being sampled, and the thread waiting for them.
+   */
+  struct ProbeGroup {
+    ProbeGroup(size_t count, probe_clock_t::time_point deadline)
+      : deadline(deadline),
+        remaining(count),
+        active(false),
+        done(false) { }
+
+    const probe_clock_t::time_point deadline;
+
+    std::mutex mutex;
+    // notified whenever anything below changes, or when a device has collected all its samples
+    std::condition_variable cv;
+    // number of devices which haven't finished being sampled
+    size_t remaining;
+    // whether any device has been found to be clearly active
+    bool active;
+    // tells any devices still being sampled to stop early
+    bool done;
+  };
+
+  /**
+   * The outcome of sampling a single device.
+   */
+  struct Probe {
+    Probe(const std::string& device)
+      : device(device),
+        started(false),
+        ok(false),
+        complete(false),
+        sum(0),
+        latency(0) { }
+
+    std::string device;
+    // whether sampling was attempted before the group gave up
+    bool started;
+    // whether the device could be sampled at all
+    bool ok;
+    // whether all SAMPLE_COUNT samples were collected before sampling was stopped
+    bool complete;
+    size_t sum;
+    probe_clock_t::duration latency;
+  };
+
+#ifdef SOUNDVIEW_OPENAL_PROBE
+
+  // sf::SoundRecorder's default rate
+  const static ALCuint PROBE_SAMPLE_RATE = 44100;
+
+  /**
+   * Samples a device with OpenAL directly. SFML only allows one device to be recorded at a time,
+   * while OpenAL itself has no such limit, so this is what lets devices be sampled concurrently.
+   */
+  bool sample_device(const std::string& device, ProbeGroup& group, size_t& sum, bool& complete) {
+    ALCdevice* capture = alcCaptureOpenDevice(
+        device.c_str(), PROBE_SAMPLE_RATE, AL_FORMAT_MONO16, SAMPLE_COUNT);
+    if (capture == NULL) {
+      return false;
+    }
+    alcCaptureStart(capture);
+
+    std::vector<int16_t> samples(SAMPLE_COUNT);
+    size_t samples_left = SAMPLE_COUNT;
+    std::unique_lock<std::mutex> lock(group.mutex);
+    while (samples_left > 0 && !group.done && probe_clock_t::now() < group.deadline) {
+      lock.unlock();
+      ALCint available = 0;
+      alcGetIntegerv(capture, ALC_CAPTURE_SAMPLES, 1, &available);
+      const size_t samples_to_get = std::min((size_t) std::max(available, 0), samples_left);
+      if (samples_to_get > 0) {
+        alcCaptureSamples(capture, samples.data(), samples_to_get);
+        sum += soundview::simd_kernels().abs_sum(samples.data(), samples_to_get);
+        samples_left -= samples_to_get;
+      }
+      lock.lock();
+      if (samples_left > 0) {
+        // wait for more samples, waking early if the group gives up
+        group.cv.wait_for(lock, std::chrono::duration<double>(SECS_PER_ROUND));
+      }
+    }
+    lock.unlock();
+    complete = (samples_left == 0);
+
+    alcCaptureStop(capture);
+    alcCaptureCloseDevice(capture);
+    return true;
+  }
+
+#else
 
   /**
    * Used for device auto-selection. Records a sample of PCM data from a given
@@ -45,17 +169,16 @@ namespace {
    */
   class AmplitudeSummer : public sf::SoundRecorder {
    public:
-    AmplitudeSummer(const std::string& device)
+    AmplitudeSummer(const std::string& device, ProbeGroup& group)
       : samples_left(SAMPLE_COUNT),
         sum_(0),
-        mutex(),
-        cv_notify(),
+        group(group),
         ready_to_stop(false) {
       setProcessingInterval(sf::seconds(SECS_PER_ROUND));
       setDevice(device);
     }
 
-    bool run(size_t &sum) {
+    bool run(size_t &sum, bool& complete) {
       // Single-use only.
       if (ready_to_stop) {
         return false;
@@ -64,13 +187,17 @@ namespace {
       if (!start()) {
         return false;
       }
-      // Wait for sample processing thread to accumulate enough samples and exit
+      // Wait for sample processing thread to accumulate enough samples, or for the group's
+      // deadline to pass
       {
-        std::unique_lock<std::mutex> lock(mutex);
-        while (!ready_to_stop) {
+        std::unique_lock<std::mutex> lock(group.mutex);
+        while (!ready_to_stop && !group.done) {
           DEBUG("waiting for ready_to_stop");
-          cv_notify.wait(lock);
+          if (group.cv.wait_until(lock, group.deadline) == std::cv_status::timeout) {
+            break;
+          }
         }
+        complete = ready_to_stop;
       }
       // We have to tell SFML to stop, it won't stop on its own.
       // This calls into onStop() on this thread.
@@ -92,18 +219,16 @@ namespace {
       size_t samples_to_get = (samples_len > samples_left) ? samples_left : samples_len;
       DEBUG("%lu samples left, %lu in this chunk => get %lu samples",
           samples_left, samples_len, samples_to_get);
-      for (size_t i = 0; i < samples_to_get; ++i) {
-        sum_ += std::abs(samples[i]);
-      }
+      sum_ += soundview::simd_kernels().abs_sum(samples, samples_to_get);
       samples_left -= samples_to_get;
       if (samples_left == 0) {
         // Other thread will be notified when onStop() is called by SFML
         DEBUG("no more samples needed with sum %lu", sum_);
         {
-          std::unique_lock<std::mutex> lock(mutex);
+          std::unique_lock<std::mutex> lock(group.mutex);
           DEBUG("notify should_stop");
           ready_to_stop = true;
-          cv_notify.notify_all();
+          group.cv.notify_all();
         }
         return false;
       } else {
@@ -116,15 +241,65 @@ namespace {
     size_t samples_left;
     size_t sum_;
 
-    std::mutex mutex;
-    std::condition_variable cv_notify;
+    ProbeGroup& group;
     bool ready_to_stop;
   };
 
+  bool sample_device(const std::string& device, ProbeGroup& group, size_t& sum, bool& complete) {
+    AmplitudeSummer summer(device, group);
+    return summer.run(sum, complete);
+  }
+
+#endif
+
+  /**
+   * Samples probe.device on the calling thread, then reports back to the group.
+   */
+  void probe_device(ProbeGroup& group, Probe& probe) {
+    const probe_clock_t::time_point start = probe_clock_t::now();
+    probe.started = true;
+    probe.ok = sample_device(probe.device, group, probe.sum, probe.complete);
+    probe.latency = probe_clock_t::now() - start;
+
+    std::unique_lock<std::mutex> lock(group.mutex);
+    --group.remaining;
+    if (probe.ok && probe.complete && probe.sum >= ACTIVE_AMPLITUDE * SAMPLE_COUNT) {
+      group.active = true;
+    }
+    group.cv.notify_all();
+  }
+
+  /**
+   * Returns a hash of the names of the available devices, regardless of their order. Used to tell
+   * whether the devices have changed since the last device was selected.
+   */
+  std::string devices_fingerprint(std::vector<std::string> devices) {
+    std::sort(devices.begin(), devices.end());
+    // 64-bit FNV-1a, with each name including its terminating NUL
+    uint64_t hash = 14695981039346656037ULL;
+    for (const std::string& device : devices) {
+      for (size_t i = 0; i <= device.size(); ++i) {
+        hash = (hash ^ (uint8_t) device.c_str()[i]) * 1099511628211ULL;
+      }
+    }
+    std::ostringstream oss;
+    oss << std::hex << hash;
+    return oss.str();
+  }
+
 }
 
-soundview::DeviceSelector::DeviceSelector(status_func_t status_cb)
-  : status_cb(status_cb) { }
+soundview::DeviceSelector::DeviceSelector(const Options& options, status_func_t status_cb)
+  : status_cb(status_cb),
+    cache_path(state_file_path(options.state_dir(), CACHE_FILE_NAME)) { }
+
+bool soundview::DeviceSelector::can_sample_while_recording() {
+#ifdef SOUNDVIEW_OPENAL_PROBE
+  return true;
+#else
+  return false;
+#endif
+}
 
 std::vector<std::string> soundview::DeviceSelector::list_devices() {
   if (!sf::SoundRecorder::isAvailable()) {
@@ -155,32 +330,69 @@ bool soundview::DeviceSelector::auto_select(std::string& device) {
       // user has closed window, give up
       return false;
     }
+
+    // stop sampling once every device has been sampled, one is clearly active, or the deadline
+    // passes. whatever has been collected by then is used to pick a device.
+    ProbeGroup group(all_devices.size(), probe_clock_t::now() + PROBE_DEADLINE);
+    std::vector<Probe> probes(all_devices.begin(), all_devices.end());
+#ifdef SOUNDVIEW_OPENAL_PROBE
+    // sample all devices at once, each on its own thread
+    std::vector<std::thread> threads;
+    threads.reserve(probes.size());
+    for (Probe& probe : probes) {
+      threads.push_back(std::thread(probe_device, std::ref(group), std::ref(probe)));
+    }
+    {
+      std::unique_lock<std::mutex> lock(group.mutex);
+      group.cv.wait_until(lock, group.deadline,
+          [&group]() { return group.remaining == 0 || group.active; });
+      group.done = true;
+      group.cv.notify_all();
+    }
+    for (std::thread& thread : threads) {
+      thread.join();
+    }
+#else
+    // SFML can only record from one device at a time, so sample them one after another
+    for (Probe& probe : probes) {
+      if (group.active || probe_clock_t::now() >= group.deadline) {
+        break;
+      }
+      probe_device(group, probe);
+    }
+#endif
+
     size_t num = 0;
-    for (const std::string& d : all_devices) {
-      LOG("  %lu: %s ..", ++num, d.c_str());
-      AmplitudeSummer summer(d);
-      size_t sum;
-      if (summer.run(sum)) {
-        if (sum == 0) {
-          LOG("     no data");
-          continue;
-        } else {
-          LOG("     %lu amplitude units", sum);
-        }
+    for (const Probe& probe : probes) {
+      const double latency_ms =
+        std::chrono::duration<double, std::milli>(probe.latency).count();
+      LOG("  %lu: %s ..", ++num, probe.device.c_str());
+      if (!probe.started) {
+        LOG("     skipped");
+        continue;
+      }
+      if (!probe.ok) {
+        LOG("     sampling FAILED after %.0fms", latency_ms);
+        continue;
+      }
+      if (probe.sum == 0) {
+        LOG("     no data after %.0fms%s", latency_ms, probe.complete ? "" : " (stopped early)");
+        continue;
+      }
+      LOG("     %lu amplitude units in %.0fms%s", probe.sum, latency_ms,
+          probe.complete ? "" : " (stopped early)");
 
-        if (sum > best_device_sum) {
-          // loudest device wins
-          best_device = d;
-          best_device_sum = sum;
-        }
-      } else {
-        LOG("     sampling FAILED");
+      if (probe.sum > best_device_sum) {
+        // loudest device wins
+        best_device = probe.device;
+        best_device_sum = probe.sum;
       }
     }
     if (best_device_sum > 0) {
       // found at least one device with some non-zero data
       LOG("=> Autoselected device: %s", best_device.c_str());
       device = best_device;
+      save_cached(device, all_devices);
       return true;
     }
     // all devices are muted. sleep for a bit and try again
@@ -195,3 +407,78 @@ bool soundview::DeviceSelector::auto_select(std::string& device) {
     }
   }
 }
+
+bool soundview::DeviceSelector::select_cached(std::string& device) {
+  if (cache_path.empty()) {
+    return false;
+  }
+  std::ifstream in(cache_path.c_str());
+  if (!in) {
+    return false;
+  }
+  // one 'key=value' per line
+  std::string cached_device, cached_fingerprint, line;
+  time_t cached_time = 0;
+  while (std::getline(in, line)) {
+    const size_t sep = line.find('=');
+    if (sep == std::string::npos) {
+      continue;
+    }
+    const std::string key = line.substr(0, sep), value = line.substr(sep + 1);
+    if (key == "device") {
+      cached_device = value;
+    } else if (key == "time") {
+      cached_time = strtoll(value.c_str(), NULL, 10);
+    } else if (key == "devices") {
+      cached_fingerprint = value;
+    }
+  }
+  if (cached_device.empty()) {
+    return false;
+  }
+
+  std::vector<std::string> all_devices = list_devices();
+  if (std::find(all_devices.begin(), all_devices.end(), cached_device) == all_devices.end()) {
+    LOG("Last used device is gone, sampling all devices: %s", cached_device.c_str());
+    return false;
+  }
+  LOG("Trying last used device, selected %.1f hours ago%s: %s",
+      difftime(time(NULL), cached_time) / 3600,
+      (devices_fingerprint(all_devices) == cached_fingerprint) ? "" : " with different devices",
+      cached_device.c_str());
+
+  // give the device a short window to produce some audio, in case it's between songs
+  const probe_clock_t::time_point deadline = probe_clock_t::now() + CACHED_DEVICE_WINDOW;
+  do {
+    ProbeGroup group(1, deadline);
+    Probe probe(cached_device);
+    probe_device(group, probe);
+    if (!probe.ok) {
+      LOG("     sampling FAILED");
+      return false;
+    }
+    if (probe.sum > 0) {
+      LOG("=> Using last used device after %.0fms, %lu amplitude units",
+          std::chrono::duration<double, std::milli>(probe.latency).count(), probe.sum);
+      device = cached_device;
+      save_cached(device, all_devices);
+      return true;
+    }
+  } while (probe_clock_t::now() < deadline && status_cb());
+  LOG("Last used device is silent, sampling all devices");
+  return false;
+}
+
+void soundview::DeviceSelector::save_cached(
+    const std::string& device, const std::vector<std::string>& all_devices) {
+  if (cache_path.empty()) {
+    return;
+  }
+  std::ofstream out(cache_path.c_str(), std::ios::trunc);
+  out << "device=" << device << std::endl
+      << "time=" << (long long) time(NULL) << std::endl
+      << "devices=" << devices_fingerprint(all_devices) << std::endl;
+  if (!out) {
+    ERROR("Failed to save selected device to %s", cache_path.c_str());
+  }
+}
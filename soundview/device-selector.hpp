@@ -18,16 +18,18 @@
 
 #include <functional>
 #include <memory>
+#include <string>
 #include <vector>
 
 #include "soundview/config.hpp"
+#include "soundview/options.hpp"
 
 namespace soundview {
   typedef std::function<bool()> status_func_t;
 
   class LIB_API DeviceSelector {
    public:
-    DeviceSelector(status_func_t status_cb);
+    DeviceSelector(const Options& options, status_func_t status_cb);
 
     /**
      * Produces a list of all available audio devices. List may be empty if
@@ -41,10 +43,31 @@ namespace soundview {
      * device which is producing the highest amplitudes. Returns `true` and sets
      * 'device' to the device label when a device is found, or gives up and
      * returns false if no recordable devices are available.
+     *
+     * Sampling stops early once a device is clearly active, or after a
+     * deadline, in which case the loudest device sampled so far wins.
      */
     bool auto_select(std::string& device);
 
+    /**
+     * Tries the device which was last picked by auto_select(), which is kept
+     * in the state dir across runs. Returns `true` and sets 'device' if that
+     * device is still present and produces some audio within a short window,
+     * or returns false if auto_select() should be used instead.
+     */
+    bool select_cached(std::string& device);
+
+    /**
+     * Returns whether auto_select() works while an sf::SoundRecorder is
+     * recording. SFML only allows one device to be recorded at a time, so
+     * this requires a build which samples devices with OpenAL directly.
+     */
+    static bool can_sample_while_recording();
+
    private:
+    void save_cached(const std::string& device, const std::vector<std::string>& all_devices);
+
     const status_func_t status_cb;
+    const std::string cache_path;
   };
 }
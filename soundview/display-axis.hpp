@@ -0,0 +1,181 @@
+/* SoundView - Eye candy for your music
+ * Copyright (C) 2016 Nicholas Parker
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>. */
+
+
+#pragma once
+
+#include <stddef.h>
+#include <algorithm>
+
+#include <SFML/Graphics/Rect.hpp>
+#include <SFML/Graphics/Vertex.hpp>
+
+#include "soundview/hsl.hpp"
+
+namespace soundview {
+
+  /*
+   * Axis policies for DisplayImpl's rasterizer. The voiceprint and analyzer are drawn in terms of
+   * a time axis, along which columns scroll, and a bucket axis, along which frequencies are laid
+   * out from lowest to highest. A policy maps those onto screen coordinates for one orientation,
+   * so that the drawing code can be written once and specialized for each orientation at compile
+   * time.
+   *
+   * Positions along the time axis within a region are measured from the region's starting edge,
+   * so that the voiceprint's ring of columns behaves the same way in both orientations: new
+   * columns go at voiceprint_edge, which then advances by the scroll rate and wraps around to 0.
+   *
+   * Quads are indexed 0=botleft, 1=botright, 2=topright, 3=topleft.
+   */
+
+  /**
+   * Time runs left to right, with buckets running bottom to top. The analyzer is on the right edge.
+   */
+  struct HorizAxis {
+    static size_t time_len(size_t width, size_t /*height*/) {
+      return width;
+    }
+    static size_t bucket_len(size_t /*width*/, size_t height) {
+      return height;
+    }
+
+    static sf::IntRect voiceprint_rect(size_t width, size_t height, size_t analyzer_thickness) {
+      return sf::IntRect(0, 0, width - analyzer_thickness, height);
+    }
+    static sf::IntRect analyzer_rect(size_t width, size_t height, size_t analyzer_thickness) {
+      return sf::IntRect(width - analyzer_thickness, 0, analyzer_thickness, height);
+    }
+
+    /**
+     * Returns the part of 'region' which covers [start, end) along the time axis.
+     */
+    static sf::IntRect time_rect(const sf::IntRect& region, size_t start, size_t end) {
+      return sf::IntRect(region.left + start, region.top, end - start, region.height);
+    }
+
+    /**
+     * Returns the offset to draw a column at 'pos' along the time axis within 'region', where
+     * 'pos' may be negative to draw past the region's starting edge.
+     */
+    static sf::Vector2f time_offset(const sf::IntRect& region, float pos) {
+      return sf::Vector2f(region.left + pos, 0);
+    }
+
+    /**
+     * Returns the window coordinate of the start of 'region' along the time axis, and the
+     * direction that time runs from there.
+     */
+    static float time_origin(const sf::IntRect& region) {
+      return region.left;
+    }
+    static float time_step(float len) {
+      return len;
+    }
+
+    static void set_time_span(sf::Vertex* quad, float start, float end) {
+      quad[0].position.x = quad[3].position.x = start;
+      set_time_end(quad, end);
+    }
+    static void set_time_end(sf::Vertex* quad, float end) {
+      quad[1].position.x = quad[2].position.x = end;
+    }
+    static void set_bucket_span(sf::Vertex* quad, float axis_len, float start, float end) {
+      quad[0].position.y = quad[1].position.y = axis_len - start;
+      quad[2].position.y = quad[3].position.y = axis_len - end;
+    }
+
+    /**
+     * Returns the rect of a repeating texture of 'size' which unrolls its ring of columns, from
+     * the oldest at 'edge' to the newest just before it.
+     */
+    static sf::IntRect ring_rect(const sf::Vector2u& size, size_t edge) {
+      return sf::IntRect(edge, 0, size.x, size.y);
+    }
+
+    /**
+     * Writes a 'thickness'-wide column of 'colors' into 'out', with the lowest buckets at the
+     * bottom and each line of pixels 'stride' pixels apart.
+     */
+    static void write_strip(const rgba_t* colors, size_t axis_len,
+        rgba_t* out, size_t stride, size_t thickness) {
+      for (size_t y = 0; y < axis_len; ++y) {
+        std::fill_n(out + (y * stride), thickness, colors[axis_len - 1 - y]);
+      }
+    }
+  };
+
+  /**
+   * Time runs bottom to top, with buckets running left to right. The analyzer is on the top edge.
+   */
+  struct VertAxis {
+    static size_t time_len(size_t /*width*/, size_t height) {
+      return height;
+    }
+    static size_t bucket_len(size_t width, size_t /*height*/) {
+      return width;
+    }
+
+    static sf::IntRect voiceprint_rect(size_t width, size_t height, size_t analyzer_thickness) {
+      return sf::IntRect(0, analyzer_thickness, width, height - analyzer_thickness);
+    }
+    static sf::IntRect analyzer_rect(size_t width, size_t /*height*/, size_t analyzer_thickness) {
+      return sf::IntRect(0, 0, width, analyzer_thickness);
+    }
+
+    static sf::IntRect time_rect(const sf::IntRect& region, size_t start, size_t end) {
+      return sf::IntRect(region.left, region.top + region.height - end, region.width, end - start);
+    }
+
+    static sf::Vector2f time_offset(const sf::IntRect& region, float pos) {
+      return sf::Vector2f(0, region.top + region.height - pos);
+    }
+
+    static float time_origin(const sf::IntRect& region) {
+      return region.top + region.height;
+    }
+    static float time_step(float len) {
+      return -len;
+    }
+
+    static void set_time_span(sf::Vertex* quad, float start, float end) {
+      quad[0].position.y = quad[1].position.y = start;
+      set_time_end(quad, end);
+    }
+    static void set_time_end(sf::Vertex* quad, float end) {
+      quad[2].position.y = quad[3].position.y = end;
+    }
+    static void set_bucket_span(sf::Vertex* quad, float /*axis_len*/, float start, float end) {
+      quad[0].position.x = quad[3].position.x = start;
+      quad[1].position.x = quad[2].position.x = end;
+    }
+
+    static sf::IntRect ring_rect(const sf::Vector2u& size, size_t edge) {
+      return sf::IntRect(0, (size.y - edge) % size.y, size.x, size.y);
+    }
+
+    /**
+     * Writes a 'thickness'-tall row of 'colors' into 'out', with the lowest buckets at the left
+     * and each line of pixels 'stride' pixels apart.
+     */
+    static void write_strip(const rgba_t* colors, size_t axis_len,
+        rgba_t* out, size_t stride, size_t thickness) {
+      for (size_t y = 0; y < thickness; ++y) {
+        std::copy(colors, colors + axis_len, out + (y * stride));
+      }
+    }
+  };
+
+}
@@ -15,7 +15,7 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>. */
 
 #include <math.h>
-#include <condition_variable>
+#include <algorithm>
 #include <limits>
 
 #include <SFML/Graphics/Image.hpp>
@@ -24,11 +24,18 @@
 #include <SFML/Window/Event.hpp>
 
 #include "soundview/config.hpp"
+#include "soundview/display-axis.hpp"
 #include "soundview/display-impl.hpp"
+#include "soundview/simd-kernels.hpp"
 
 namespace {
   const char* TITLE = "SoundView";
 
+  // floor for the loudness ceiling when scaling values against it. the ceiling starts out at
+  // (and is reset to) the smallest double, whose reciprocal overflows a float to infinity, and a
+  // silent device would then scale its zeroes to NaN.
+  const double MIN_DEVICE_MAX_FREQ_VAL = 1e-6;
+
   /**
    * Resets a region to black, WITHOUT calling target.clear() which introduces flicker
    */
@@ -52,7 +59,9 @@ namespace {
   }
 }
 
-soundview::DisplayImpl::DisplayImpl(const Options& options, reload_device_func_t reload_device_func)
+soundview::DisplayImpl::DisplayImpl(
+    const Options& options, FramePool& pool, FrameReducer& reducer,
+    reload_device_func_t reload_device_func, reload_status_func_t reload_status_func)
   : analyzer_thickness_pct(options.analyzer_width_pct()),
     fullscreen(options.display_fullscreen()),
     vsync(options.display_vsync()),
@@ -60,18 +69,53 @@ soundview::DisplayImpl::DisplayImpl(const Options& options, reload_device_func_t
     bucket_count(options.bucket_count()),
     bucket_bass_exaggeration(options.bucket_bass_exaggeration() / 10.),
     voiceprint_scroll_rate(options.voiceprint_scroll_rate()),
+    voiceprint_pixels(options.voiceprint_renderer() == "pixels"),
+    render_scale(options.display_render_scale() / 100.),
+    render_smooth(options.display_render_filter() == "linear"),
     loudness_adjust_rate(1 - (options.loudness_adjust_rate() / 100.)),
     hsl(options),
+    pool(pool),
+    reducer(reducer),
     reload_device_func(reload_device_func),
+    reload_status_func(reload_status_func),
     horiz(false),
+    device_switching(false),
     analyzer_thickness(0),
     window_width(0),
     window_height(0),
     bucket_cached_view_size(0),
     voiceprint_edge(0),
+    column_vertices(sf::Quads, bucket_count * 4),
+    analyzer_vertices(sf::Quads, bucket_count * 4),
+    bucket_colors(bucket_count),
+    analyzer_values(bucket_count),
+    analyzer_len(0),
+    pixel_map_generation(0),
+    pixel_levels_valid(false),
+    history(options),
+    prev_levels(NULL),
+    pyramid(options),
+    scrollback(false),
+    scrollback_changed(false),
+    scrollback_level(0),
+    scrollback_age(0),
+    scrollback_stat(ColumnPyramid::STAT_MAX),
+    present_pending(false),
+    frame_queue(pool.size()),
+    scheduler(options, pool),
     device_max_freq_val(std::numeric_limits<double>::min()),
+    wake_interval(1000000 / fps_max),
+    waiting(false),
     shutdown(false) { }
 
+soundview::DisplayImpl::~DisplayImpl() {
+  // frames which arrived after run() exited. the scheduler returns its own frames afterwards
+  Frame* frame;
+  while (frame_queue.pop(frame)) {
+    pool.release(frame);
+  }
+}
+
 void soundview::DisplayImpl::run() {
   sf::RenderWindow window;
   if (fullscreen) {
@@ -90,50 +134,158 @@ void soundview::DisplayImpl::run() {
   // init to black so that resizes before voiceprint has filled the screen look clean
   reset_all(texture);
 
-  std::vector<std::vector<double> >* freqs = NULL;
+  std::vector<const Frame*> columns;
+  columns.reserve(frame_queue.capacity());
   while (window.isOpen()) {
-    {
-      std::unique_lock<std::mutex> lock(mutex);
-      if (shutdown) {
-        window.close();
-        break;
-      }
-      // Grab any output from double buffers
-      freqs = buf_freqs.get();
+    if (shutdown) {
+      window.close();
+      break;
+    }
+    // Hand any frames which have arrived since the last pass to the scheduler, which decides
+    // which columns are due to be drawn. Scrolling is driven by elapsed time rather than by how
+    // many frames happened to arrive, so that bursty audio callbacks don't make it stutter.
+    Frame* frame;
+    while (frame_queue.pop(frame)) {
+      scheduler.add(frame);
+    }
+    scheduler.advance(frame_clock_t::now(), columns);
+    if (columns.empty() && !present_pending) {
+      // Nothing to draw yet. Sleep until the next column is due or more frames show up, rather
+      // than spinning on pollEvent(). The wait is capped at one frame period so that window
+      // events are still handled promptly when audio isn't arriving.
+      wait_for_frames(std::min(scheduler.next_due(), frame_clock_t::now() + wake_interval));
+    } else {
+      draw_freq_data(window, texture, columns);
     }
-
-    //TODO this loop is prone to stuttering. maybe add a timer to smooth the rate?
-
-    draw_freq_data(window, texture, *freqs);
-    freqs->clear();
     bool was_resized = handle_user_events(window);
+    const bool switching = reload_status_func();
+    if (switching != device_switching) {
+      device_switching = switching;
+      if (!switching) {
+        // the new device may be much quieter or louder than the old one
+        device_max_freq_val = std::numeric_limits<double>::min();
+      }
+      update_title(window);
+    }
     if (was_resized && !handle_resize(window, texture)) {
       window.close();
+    } else if (scrollback_changed) {
+      scrollback_changed = false;
+      if (!redraw_voiceprint(texture)) {
+        window.close();
+      }
+      present_pending = true;
+      update_title(window);
     }
   }
+  LOG("Frames: %lu enqueued, %lu dequeued, %lu dropped by queue, %lu dropped by pool",
+      frame_queue.enqueued(), frame_queue.dequeued(), frame_queue.dropped(), pool.exhausted());
+  scheduler.log_stats();
 }
 
 // The following are all called on a separate thread from run():
 
-bool soundview::DisplayImpl::append_freq_data(const std::vector<double>& freq_data) {
-  std::unique_lock<std::mutex> lock(mutex);
-  DEBUG("input freqs: %lu", freq_data.size());
-  buf_freqs.add(freq_data);
+bool soundview::DisplayImpl::append_frames(const std::vector<Frame*>& frames) {
+  DEBUG("input frames: %lu", frames.size());
+  for (Frame* frame : frames) {
+    // can't fail: the queue has room for every frame in the pool
+    frame_queue.push(frame);
+  }
+  // pairs with the fence in wait_for_frames(): either run() sees the frames we just pushed, or we
+  // see that it's waiting and wake it up
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  if (waiting) {
+    wake_run();
+  }
   return !shutdown;
 }
 
 bool soundview::DisplayImpl::check_running() {
-  std::unique_lock<std::mutex> lock(mutex);
   return !shutdown;
 }
 
 void soundview::DisplayImpl::exit() {
-  std::unique_lock<std::mutex> lock(mutex);
   shutdown = true;
+  wake_run();
 }
 
 // Private:
 
+size_t soundview::DisplayImpl::scrollback_size(size_t level) const {
+  return (level == 0) ? history.size() : pyramid.size(level);
+}
+
+void soundview::DisplayImpl::scroll(int pan, int zoom) {
+  const size_t voiceprint_len = (horiz ? window_width : window_height) - analyzer_thickness;
+  const size_t fit = voiceprint_len / voiceprint_scroll_rate;
+  if (!scrollback) {
+    // pause on what's currently shown
+    scrollback = true;
+    scrollback_level = 0;
+    scrollback_age = 0;
+  }
+  if (zoom > 0 && scrollback_level > 0) {
+    --scrollback_level;
+  } else if (zoom < 0 && scrollback_level < pyramid.level_count()
+      && scrollback_size(scrollback_level + 1) > 0) {
+    ++scrollback_level;
+  }
+  // pan by a quarter of the voiceprint at the current zoom. redraw_voiceprint() clamps to what's
+  // available
+  const size_t step = std::max<size_t>(fit / 4, 1) << scrollback_level;
+  if (pan > 0) {
+    scrollback_age += step;
+  } else if (pan < 0) {
+    scrollback_age = (scrollback_age > step) ? scrollback_age - step : 0;
+  }
+  scrollback_changed = true;
+}
+
+void soundview::DisplayImpl::update_title(sf::RenderWindow& window) {
+  const char* device = device_switching ? " - Switching device (D to cancel)" : "";
+  if (!scrollback) {
+    char buf[128];
+    snprintf(buf, sizeof(buf), "%s%s", TITLE, device);
+    window.setTitle(buf);
+    return;
+  }
+  const char* stat = "";
+  if (scrollback_level > 0) {
+    switch (scrollback_stat) {
+      case ColumnPyramid::STAT_MAX:
+        stat = ", max";
+        break;
+      case ColumnPyramid::STAT_MEAN:
+        stat = ", mean";
+        break;
+      default:
+        stat = ", min";
+        break;
+    }
+  }
+  char buf[128];
+  snprintf(buf, sizeof(buf), "%s%s - Scrollback: %.1fs ago, 1:%lu%s (End to resume)", TITLE,
+      device, scrollback_age / (double) fps_max, (unsigned long) 1 << scrollback_level, stat);
+  window.setTitle(buf);
+}
+
+void soundview::DisplayImpl::wait_for_frames(frame_clock_t::time_point deadline) {
+  std::unique_lock<std::mutex> lock(wake_mutex);
+  waiting = true;
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  // check again now that 'waiting' is visible, in case frames arrived just before it was set
+  if (frame_queue.empty() && !shutdown) {
+    wake_cond.wait_until(lock, deadline);
+  }
+  waiting = false;
+}
+
+void soundview::DisplayImpl::wake_run() {
+  // taking the lock ensures that run() is either not yet waiting, or is already inside wait_for()
+  std::lock_guard<std::mutex> lock(wake_mutex);
+  wake_cond.notify_one();
+}
+
 bool soundview::DisplayImpl::handle_user_events(sf::RenderWindow& window) {
   sf::Event event;
   bool resized = false;
@@ -146,8 +298,8 @@ bool soundview::DisplayImpl::handle_user_events(sf::RenderWindow& window) {
       case sf::Event::KeyReleased:
         switch (event.key.code) {
           case sf::Keyboard::D:
-            // [D]evice reload
-            device_max_freq_val = std::numeric_limits<double>::min();
+            // [D]evice reload, in the background. frames from the current device keep arriving
+            // until the new one is ready. pressing D again cancels the reload
             reload_device_func();
             break;
 
@@ -157,6 +309,23 @@ bool soundview::DisplayImpl::handle_user_events(sf::RenderWindow& window) {
             horiz = !horiz;
             voiceprint_edge = 0;
             resized = true; // reset sizing to reflect flip
+            update_title(window);
+            break;
+
+          case sf::Keyboard::End:
+            // resume live view
+            if (scrollback) {
+              scrollback = false;
+              scrollback_changed = true;
+            }
+            break;
+          case sf::Keyboard::M:
+            // [M]ax/mean/min when zoomed out
+            if (scrollback) {
+              scrollback_stat =
+                (ColumnPyramid::Stat)((scrollback_stat + 1) % ColumnPyramid::STAT_COUNT);
+              scrollback_changed = true;
+            }
             break;
 
           // many ways to exit:
@@ -182,6 +351,27 @@ bool soundview::DisplayImpl::handle_user_events(sf::RenderWindow& window) {
             break;
         }
         break;
+      case sf::Event::KeyPressed:
+        // handled on press rather than release, so that holding them down repeats
+        switch (event.key.code) {
+          case sf::Keyboard::Left:
+            scroll(1, 0); // older
+            break;
+          case sf::Keyboard::Right:
+            scroll(-1, 0); // newer
+            break;
+          case sf::Keyboard::Dash:
+          case sf::Keyboard::Subtract:
+            scroll(0, -1); // zoom out
+            break;
+          case sf::Keyboard::Equal:
+          case sf::Keyboard::Add:
+            scroll(0, 1); // zoom in
+            break;
+          default:
+            break;
+        }
+        break;
       case sf::Event::Resized:
         resized = true;
         break;
@@ -194,251 +384,185 @@ bool soundview::DisplayImpl::handle_user_events(sf::RenderWindow& window) {
 
 void soundview::DisplayImpl::draw_freq_data(
     sf::RenderWindow& window, sf::RenderTexture& texture,
-    std::vector<std::vector<double> >& freq_sets) {
-  if (freq_sets.empty()) {
+    const std::vector<const Frame*>& freq_sets) {
+  if (freq_sets.empty() && !present_pending) {
+    return;
+  }
+  if (!present_pending && scrollback && analyzer_thickness_pct == 0) {
+    // paused on the scrollback without an analyzer: new columns are only recorded, so nothing on
+    // screen changes. skip redrawing and presenting the window, which would repaint the same
+    // pixels. the window can't be repainted partially instead, since its contents aren't kept
+    // across presents
+    for (const Frame* frame : freq_sets) {
+      quantize_column(frame);
+    }
+    device_max_freq_val *= loudness_adjust_rate;
     return;
   }
+  present_pending = false;
 
   if (horiz) {
-    draw_freq_data_horiz(window, texture, freq_sets);
+    draw_freq_data_axis<HorizAxis>(window, texture, freq_sets);
   } else {
-    draw_freq_data_vert(window, texture, freq_sets);
+    draw_freq_data_axis<VertAxis>(window, texture, freq_sets);
   }
 }
 
-void soundview::DisplayImpl::draw_freq_data_horiz(
-    sf::RenderWindow& window, sf::RenderTexture& texture,
-    std::vector<std::vector<double> >& freq_sets) {
-  double bucket_y;
-  double val_orig;
-  double val_relative;
-  size_t i;
-
-  sf::VertexArray quad(sf::Quads, 4);
-
-  // first, draw voiceprint and analyzer to the texture
-
-  const bool voiceprint_enabled = analyzer_thickness_pct < 100;
-  if (voiceprint_enabled) {
-    // voiceprint
-
-    for (const std::vector<double>& data : freq_sets) { // iterate over columns
-      // 0=botleft, 1=botright, 2=topright, 3=topleft
-      // left and right stay const for the column. note that 'right' may extend beyond the
-      // right edge of the texture, so we need to check for any needed wraparound handling
-
-      // left is straightforward:
-      quad[0].position.x = quad[3].position.x = voiceprint_edge;// left
-      // right edge needs to check for wraparound:
-      size_t new_left_edge =
-        (voiceprint_edge + voiceprint_scroll_rate) % (window_width - analyzer_thickness);
-      if (new_left_edge < voiceprint_edge) {
-        // we're wrapping around the texture. (drawing on left edge of texture is handled below)
-        quad[1].position.x = quad[2].position.x = window_width - analyzer_thickness;// right
-      } else {
-        // all in one contiguous region
-        quad[1].position.x = quad[2].position.x = new_left_edge;// right
-      }
-
-      bucket_y = window_height;
-      for (i = 0; i < data.size(); ++i) {
-        // while we're in here, calculate device max amplitude (also used in analyzer below)
-        val_orig = data[i];
-        if (val_orig > device_max_freq_val) {
-          device_max_freq_val = val_orig;
-        }
-        val_relative = val_orig / device_max_freq_val;
-
-        // 0=botleft, 1=botright, 2=topright, 3=topleft
-        quad[0].position.y = quad[1].position.y = bucket_y;// bottom
-        bucket_y -= bucket_widths[i];
-        quad[2].position.y = quad[3].position.y = bucket_y;// top
-        quad[0].color = quad[1].color = quad[2].color = quad[3].color
-          = hsl.valueToColor(val_relative);
-        texture.draw(quad);
-      }
+bool soundview::DisplayImpl::frame_stale(const Frame* frame) const {
+  return frame->reduced != 0 && frame->reduced != pixel_map_generation;
+}
 
-      if (new_left_edge < voiceprint_edge && new_left_edge != 0) {
-        // we've wrapped around the texture and there's a margin on the left edge to cover.
-        // repeat the draw operation for the left edge of the texture
-        quad[0].position.x = quad[3].position.x = 0;// left
-        quad[1].position.x = quad[2].position.x = new_left_edge;// right
-
-        bucket_y = window_height;
-        for (i = 0; i < data.size(); ++i) {
-          // 0=botleft, 1=botright, 2=topright, 3=topleft
-          quad[0].position.y = quad[1].position.y = bucket_y;// bottom
-          bucket_y -= bucket_widths[i];
-          quad[2].position.y = quad[3].position.y = bucket_y;// top
-          quad[0].color = quad[1].color = quad[2].color = quad[3].color
-            = hsl.valueToColor(data[i] / device_max_freq_val);
-          texture.draw(quad);
-        }
+const uint8_t* soundview::DisplayImpl::quantize_column(const Frame* frame) {
+  // store the column's levels in the history, where they're also used for coloring it
+  uint8_t* levels = history.push();
+  pixel_levels_valid = false;
+  if (frame_stale(frame)) {
+    // reduced with a pixel map from before the last resize, so we can't tell which buckets its
+    // values belong to. just repeat the previous column
+    if (prev_levels != NULL && prev_levels != levels) {
+      std::copy(prev_levels, prev_levels + bucket_count, levels);
+    }
+  } else {
+    // update device max amplitude (also used in analyzer) before scaling anything against it
+    const freq_t* data = frame->data;
+    const size_t len = std::min(frame->len, bucket_count);
+    const SimdKernels& kernels = simd_kernels();
+    const freq_t frame_max = kernels.max_value(data, len, 0);
+    if (frame_max > device_max_freq_val) {
+      device_max_freq_val = frame_max;
+    }
+    const float scale = 255 / std::max(device_max_freq_val, MIN_DEVICE_MAX_FREQ_VAL);
+    if (frame->reduced != 0) {
+      // one value per pixel: keep those for drawing, and expand them back out to buckets for the
+      // history
+      kernels.quantize(data, len, scale, pixel_levels.data());
+      for (size_t i = 0; i < bucket_count; ++i) {
+        levels[i] = pixel_levels[bucket_pixel[i]];
       }
-      voiceprint_edge = new_left_edge;
+      pixel_levels_valid = true;
+    } else {
+      kernels.quantize(data, len, scale, levels);
+      std::fill(levels + len, levels + bucket_count, 0);
     }
   }
-  if (analyzer_thickness_pct > 0) {
-    // analyzer
-    // NOTE: this could be drawn directly to the window instead of reusing voiceprint's texture,
-    // but then it slightly misaligns with the voiceprint. to keep things looking tidy we also draw
-    // this to the same texture.
+  prev_levels = levels;
+  pyramid.add(levels);
+  if (scrollback) {
+    // keep the scrollback view anchored to the same point in time
+    ++scrollback_age;
+  }
+  return levels;
+}
 
-    // reset analyzer region to black
-    const size_t analyzer_left = window_width - analyzer_thickness;
-    reset_region(texture, quad,
-        analyzer_left,// left
-        analyzer_left + analyzer_thickness,// right
-        0,// bottom
-        window_height);//top
+void soundview::DisplayImpl::update_column_colors(const Frame* frame) {
+  const uint8_t* levels = quantize_column(frame);
+  hsl.levelsToRgba(levels, bucket_count, bucket_colors.data());
+  for (size_t i = 0; i < bucket_count; ++i) {
+    sf::Vertex* quad = &column_vertices[i * 4];
+    quad[0].color = quad[1].color = quad[2].color = quad[3].color = HSL::unpack(bucket_colors[i]);
+  }
+}
 
-    // if multiple sets are provided, just render the last/most recent one.
-    const std::vector<double>& analyzer_data = freq_sets[freq_sets.size() - 1];
-    bucket_y = window_height;
-    // 0=botleft, 1=botright, 2=topright, 3=topleft
-    quad[0].position.x = quad[3].position.x = analyzer_left;// left (const)
-    for (i = 0; i < analyzer_data.size(); ++i) {
-      if (!voiceprint_enabled) {
-        // normally voiceprint would do this, but it's not running
-        val_orig = analyzer_data[i];
-        if (val_orig > device_max_freq_val) {
-          device_max_freq_val = val_orig;
-        }
-        val_relative = val_orig / device_max_freq_val;
-      } else {
-        val_relative = analyzer_data[i] / device_max_freq_val;
-      }
-      // 0=botleft, 1=botright, 2=topright, 3=topleft
-      quad[1].position.x = quad[2].position.x
-        = analyzer_left + (analyzer_thickness * val_relative);// right (depends on val)
-      quad[0].position.y = quad[1].position.y = bucket_y;// bottom
-      bucket_y -= bucket_widths[i];
-      quad[2].position.y = quad[3].position.y = bucket_y;// top
-      quad[0].color = quad[1].color = quad[2].color = quad[3].color
-        = hsl.valueToColor(val_relative);
-      texture.draw(quad);
+void soundview::DisplayImpl::update_axis_colors(const uint8_t* levels) {
+  // each pixel along the bucket axis gets the loudest of the buckets which land on it
+  for (size_t px = 0; px < pixel_levels.size(); ++px) {
+    uint8_t level = 0;
+    for (size_t i = axis_bucket_start[px]; i < axis_bucket_end[px]; ++i) {
+      level = std::max(level, levels[i]);
     }
+    pixel_levels[px] = level;
   }
-  texture.display();
-
-  // second, use sprites to draw regions of the texture to the window
-
-  sf::Sprite sprite(texture.getTexture());
-  if (voiceprint_enabled) {
-    // paint what's to the right of voiceprint_edge on left edge of the display (oldest data)
-    sprite.setTextureRect(
-        sf::IntRect(
-            voiceprint_edge,// left
-            0,// top
-            window_width - analyzer_thickness - voiceprint_edge,// width
-            window_height));// height
-    window.draw(sprite);
+  hsl.levelsToRgba(pixel_levels.data(), pixel_levels.size(), axis_colors.data());
+}
 
-    // then paint what's to the left of voiceprint_edge on right edge of the display (newest data)
-    sprite.setTextureRect(
-        sf::IntRect(
-            0,// left
-            0,// top
-            voiceprint_edge,// width
-            window_height));// height
-    sprite.setPosition(window_width - analyzer_thickness - voiceprint_edge, 0);
-    window.draw(sprite);
+template <typename Axis>
+void soundview::DisplayImpl::draw_column_pixels(const Frame* frame) {
+  const uint8_t* levels = quantize_column(frame);
+  if (pixel_levels_valid) {
+    // the transformer already reduced the frame to our pixels
+    hsl.levelsToRgba(pixel_levels.data(), pixel_levels.size(), axis_colors.data());
+  } else {
+    update_axis_colors(levels);
   }
-  if (analyzer_thickness_pct > 0) {
-    // analyzer is simpler than voiceprint, just rendered in-place
-    sprite.setTextureRect(
-        sf::IntRect(
-            window_width - analyzer_thickness,// left
-            0,// top
-            analyzer_thickness,// width
-            window_height));// height
-    sprite.setPosition(window_width - analyzer_thickness, 0);
-    window.draw(sprite);
+
+  // the new column goes at voiceprint_edge, which then advances along the time axis
+  const sf::Vector2u texture_size = voiceprint_texture.getSize();
+  const size_t voiceprint_len = Axis::time_len(texture_size.x, texture_size.y);
+  const size_t thickness = std::min(voiceprint_scroll_rate, voiceprint_len);
+  const size_t start = voiceprint_edge;
+  voiceprint_edge = (voiceprint_edge + thickness) % voiceprint_len;
+  // split the upload in two if it wraps around the end of the texture
+  const size_t first_thickness = std::min(thickness, voiceprint_len - start);
+  upload_strip<Axis>(start, first_thickness);
+  if (first_thickness < thickness) {
+    upload_strip<Axis>(0, thickness - first_thickness);
   }
+}
 
-  // slowly bring ceiling back to current levels following a loud noise
-  device_max_freq_val *= loudness_adjust_rate;
-  window.display();
+template <typename Axis>
+void soundview::DisplayImpl::upload_strip(size_t pos, size_t thickness) {
+  const sf::Vector2u texture_size = voiceprint_texture.getSize();
+  const sf::IntRect strip = Axis::time_rect(
+      sf::IntRect(0, 0, texture_size.x, texture_size.y), pos, pos + thickness);
+  Axis::write_strip(axis_colors.data(), axis_colors.size(),
+      column_pixels.data(), strip.width, thickness);
+  voiceprint_texture.update(reinterpret_cast<const sf::Uint8*>(column_pixels.data()),
+      strip.width, strip.height, strip.left, strip.top);
 }
 
-void soundview::DisplayImpl::draw_freq_data_vert(
+template <typename Axis>
+void soundview::DisplayImpl::draw_freq_data_axis(
     sf::RenderWindow& window, sf::RenderTexture& texture,
-    std::vector<std::vector<double> >& freq_sets) {
-  double bucket_x;
-  double val_orig;
+    const std::vector<const Frame*>& freq_sets) {
   double val_relative;
   size_t i;
 
   sf::VertexArray quad(sf::Quads, 4);
 
+  const sf::IntRect voiceprint =
+    Axis::voiceprint_rect(window_width, window_height, analyzer_thickness);
+  const sf::IntRect analyzer =
+    Axis::analyzer_rect(window_width, window_height, analyzer_thickness);
+  const size_t voiceprint_len = Axis::time_len(voiceprint.width, voiceprint.height);
+
   // first, draw voiceprint and analyzer to the texture
 
   const bool voiceprint_enabled = analyzer_thickness_pct < 100;
   if (voiceprint_enabled) {
     // voiceprint
 
-    for (const std::vector<double>& data : freq_sets) { // iterate over rows
-      // 0=botleft, 1=botright, 2=topright, 3=topleft
-      // top and bottom stay const for the row. note that 'right' may extend beyond the
-      // top edge of the texture, so we need to check for any needed wraparound handling
-
-      if (voiceprint_edge == 0) {
-        voiceprint_edge = window_height;
-      }
-      // bottom is straightforward:
-      quad[0].position.y = quad[1].position.y = voiceprint_edge;// bottom
-      // top edge needs to check for wraparound:
-      size_t new_top_edge;
-      if (voiceprint_edge < (voiceprint_scroll_rate + analyzer_thickness)) {
-        // we're wrapping around the texture. (drawing on bottom edge of texture is handled below)
-        new_top_edge = window_height - analyzer_thickness - (voiceprint_scroll_rate - voiceprint_edge);
-        quad[2].position.y = quad[3].position.y = analyzer_thickness;// top
-      } else {
-        // all in one contiguous region
-        new_top_edge = voiceprint_edge - voiceprint_scroll_rate;
-        quad[2].position.y = quad[3].position.y = new_top_edge;// top
+    for (const Frame* frame : freq_sets) { // iterate over columns
+      if (scrollback) {
+        // keep recording while the view is paused on the scrollback
+        quantize_column(frame);
+        continue;
       }
-
-      bucket_x = 0;
-      for (i = 0; i < data.size(); ++i) {
-        // while we're in here, calculate device max amplitude (also used in analyzer below)
-        val_orig = data[i];
-        if (val_orig > device_max_freq_val) {
-          device_max_freq_val = val_orig;
-        }
-        val_relative = val_orig / device_max_freq_val;
-
-        // 0=botleft, 1=botright, 2=topright, 3=topleft
-        quad[0].position.x = quad[3].position.x = bucket_x;// left
-        bucket_x += bucket_widths[i];
-        quad[1].position.x = quad[2].position.x = bucket_x;// right
-        quad[0].color = quad[1].color = quad[2].color = quad[3].color
-          = hsl.valueToColor(val_relative);
-        texture.draw(quad);
+      if (voiceprint_pixels) {
+        draw_column_pixels<Axis>(frame);
+        continue;
       }
-
-      if (voiceprint_edge < (voiceprint_scroll_rate + analyzer_thickness)) {
-        // we've wrapped around the texture and there's a margin on the bottom edge to cover.
-        // repeat the draw operation for the bottom edge of the texture
-        // 0=botleft, 1=botright, 2=topright, 3=topleft
-        quad[0].position.y = quad[1].position.y = window_height;// bottom
-        quad[2].position.y = quad[3].position.y = new_top_edge;// top
-
-        bucket_x = 0;
-        for (i = 0; i < data.size(); ++i) {
-          // 0=botleft, 1=botright, 2=topright, 3=topleft
-          quad[0].position.x = quad[3].position.x = bucket_x;// left
-          bucket_x += bucket_widths[i];
-          quad[1].position.x = quad[2].position.x = bucket_x;// right
-          quad[0].color = quad[1].color = quad[2].color = quad[3].color
-            = hsl.valueToColor(data[i] / device_max_freq_val);
-          texture.draw(quad);
-        }
+      update_column_colors(frame);
+
+      // the column's quads are prebuilt starting at zero along the time axis, so just shift them
+      // over to voiceprint_edge. note that the column may extend beyond the end of the voiceprint,
+      // where it's either clipped or painted over by the analyzer below.
+      sf::Transform transform;
+      transform.translate(Axis::time_offset(voiceprint, voiceprint_edge));
+      texture.draw(column_vertices, sf::RenderStates(transform));
+
+      size_t new_edge = (voiceprint_edge + voiceprint_scroll_rate) % voiceprint_len;
+      if (new_edge < voiceprint_edge && new_edge != 0) {
+        // we've wrapped around the texture and there's a margin at the start of the voiceprint to
+        // cover. repeat the same column, shifted back by the length of the voiceprint
+        sf::Transform wrapped;
+        wrapped.translate(
+            Axis::time_offset(voiceprint, (float)voiceprint_edge - (float)voiceprint_len));
+        texture.draw(column_vertices, sf::RenderStates(wrapped));
       }
-      voiceprint_edge = new_top_edge;
+      voiceprint_edge = new_edge;
     }
   }
-  if (analyzer_thickness_pct > 0) {
+  if (analyzer_thickness_pct > 0 && !freq_sets.empty()) {
     // analyzer
     // NOTE: this could be drawn directly to the window instead of reusing voiceprint's texture,
     // but then it slightly misaligns with the voiceprint. to keep things looking tidy we also draw
@@ -446,72 +570,78 @@ void soundview::DisplayImpl::draw_freq_data_vert(
 
     // reset analyzer region to black
     reset_region(texture, quad,
-        0,// left
-        window_width,// right
-        analyzer_thickness,// bottom
-        0);// top
+        analyzer.left,// left
+        analyzer.left + analyzer.width,// right
+        analyzer.top,// bottom
+        analyzer.top + analyzer.height);// top
 
     // if multiple sets are provided, just render the last/most recent one.
-    const std::vector<double>& analyzer_data = freq_sets[freq_sets.size() - 1];
-    bucket_x = 0;
-    // 0=botleft, 1=botright, 2=topright, 3=topleft
-    quad[0].position.y = quad[1].position.y = analyzer_thickness;// bottom (const)
-    for (i = 0; i < analyzer_data.size(); ++i) {
+    const Frame* analyzer_frame = freq_sets[freq_sets.size() - 1];
+    const freq_t* analyzer_data = analyzer_frame->data;
+    // frames reduced to pixels are expanded back to buckets. stale ones can't be mapped to
+    // buckets, so the values from the last frame which could be are drawn again instead
+    if (!frame_stale(analyzer_frame)) {
+      if (analyzer_frame->reduced != 0) {
+        analyzer_len = bucket_count;
+        for (i = 0; i < analyzer_len; ++i) {
+          analyzer_values[i] = analyzer_data[bucket_pixel[i]];
+        }
+      } else {
+        analyzer_len = std::min(analyzer_frame->len, bucket_count);
+        std::copy(analyzer_data, analyzer_data + analyzer_len, analyzer_values.begin());
+      }
       if (!voiceprint_enabled) {
         // normally voiceprint would do this, but it's not running
-        val_orig = analyzer_data[i];
-        if (val_orig > device_max_freq_val) {
-          device_max_freq_val = val_orig;
+        const freq_t frame_max = simd_kernels().max_value(analyzer_values.data(), analyzer_len, 0);
+        if (frame_max > device_max_freq_val) {
+          device_max_freq_val = frame_max;
         }
-        val_relative = val_orig / device_max_freq_val;
-      } else {
-        val_relative = analyzer_data[i] / device_max_freq_val;
       }
-      // 0=botleft, 1=botright, 2=topright, 3=topleft
-      quad[2].position.y = quad[3].position.y
-        = analyzer_thickness - (analyzer_thickness * val_relative);// top (depends on val)
-      quad[1].position.x = quad[2].position.x = bucket_x;// left
-      bucket_x += bucket_widths[i];
-      quad[0].position.x = quad[3].position.x = bucket_x;// right
-      quad[0].color = quad[1].color = quad[2].color = quad[3].color
-        = hsl.valueToColor(val_relative);
-      texture.draw(quad);
     }
+    const double scale = 1 / std::max(device_max_freq_val, MIN_DEVICE_MAX_FREQ_VAL);
+    hsl.valuesToRgba(analyzer_values.data(), analyzer_len, scale, bucket_colors.data());
+    const float analyzer_origin = Axis::time_origin(analyzer);
+    for (i = 0; i < analyzer_len; ++i) {
+      val_relative = analyzer_values[i] * scale;
+      sf::Vertex* analyzer_quad = &analyzer_vertices[i * 4];
+      // bar length depends on val
+      Axis::set_time_end(analyzer_quad,
+          analyzer_origin + Axis::time_step(analyzer_thickness * val_relative));
+      analyzer_quad[0].color = analyzer_quad[1].color = analyzer_quad[2].color = analyzer_quad[3].color
+        = HSL::unpack(bucket_colors[i]);
+    }
+    texture.draw(analyzer_vertices);
   }
   texture.display();
 
   // second, use sprites to draw regions of the texture to the window
 
   sf::Sprite sprite(texture.getTexture());
-  if (analyzer_thickness_pct > 0) {
-    // analyzer is simpler than voiceprint, just rendered in-place
-    sprite.setTextureRect(
-        sf::IntRect(
-            0,// left
-            0,// top
-            window_width,// width
-            analyzer_thickness));// height
-    window.draw(sprite);
-  }
-  if (voiceprint_enabled) {
-    // paint what's above voiceprint_edge on the bottom edge of the display (the oldest data)
-    sprite.setTextureRect(
-        sf::IntRect(
-            0,// left
-            analyzer_thickness,// top
-            window_width,// width
-            voiceprint_edge - analyzer_thickness));// height
-    sprite.setPosition(0, window_height - (voiceprint_edge - analyzer_thickness));
+  if (voiceprint_enabled && voiceprint_pixels) {
+    // the voiceprint texture repeats, so a rect starting at voiceprint_edge unrolls it with the
+    // oldest data at the start of the time axis and the newest data at the end
+    sf::Sprite voiceprint_sprite(voiceprint_texture,
+        Axis::ring_rect(voiceprint_texture.getSize(), voiceprint_edge));
+    voiceprint_sprite.setPosition(voiceprint.left, voiceprint.top);
+    window.draw(voiceprint_sprite);
+  } else if (voiceprint_enabled) {
+    // paint what's after voiceprint_edge at the start of the voiceprint (oldest data)
+    sprite.setTextureRect(Axis::time_rect(voiceprint, voiceprint_edge, voiceprint_len));
+    const sf::IntRect oldest = Axis::time_rect(voiceprint, 0, voiceprint_len - voiceprint_edge);
+    sprite.setPosition(oldest.left, oldest.top);
     window.draw(sprite);
 
-    // then paint what's below voiceprint_edge on the top edge of the display (the newest data)
-    sprite.setTextureRect(
-        sf::IntRect(
-            0,// left
-            voiceprint_edge,// top
-            window_width,// width
-            window_height - voiceprint_edge));// height
-    sprite.setPosition(0, analyzer_thickness);
+    // then paint what's before voiceprint_edge at the end of the voiceprint (newest data)
+    sprite.setTextureRect(Axis::time_rect(voiceprint, 0, voiceprint_edge));
+    const sf::IntRect newest =
+      Axis::time_rect(voiceprint, voiceprint_len - voiceprint_edge, voiceprint_len);
+    sprite.setPosition(newest.left, newest.top);
+    window.draw(sprite);
+  }
+  if (analyzer_thickness_pct > 0) {
+    // analyzer is simpler than voiceprint, just rendered in-place
+    sprite.setTextureRect(analyzer);
+    sprite.setPosition(analyzer.left, analyzer.top);
     window.draw(sprite);
   }
 
@@ -523,31 +653,41 @@ void soundview::DisplayImpl::draw_freq_data_vert(
 bool soundview::DisplayImpl::handle_resize(
     sf::RenderWindow& window,
     sf::RenderTexture& texture) {
-  window_width = window.getView().getSize().x;
-  window_height = window.getView().getSize().y;
+  // render at a fraction of the window's resolution, and let the view scale that up to fill the
+  // window when it's presented
+  const sf::Vector2u window_size = window.getSize();
+  window_width = std::max<size_t>(1, window_size.x * render_scale + 0.5);
+  window_height = std::max<size_t>(1, window_size.y * render_scale + 0.5);
+  window.setView(sf::View(sf::FloatRect(0, 0, window_width, window_height)));
+  DEBUG("Rendering %lux%lu to window of %ux%u",
+      window_width, window_height, window_size.x, window_size.y);
 
   if (!texture.create(window_width, window_height)) {
     ERROR("Failed to create texture of width %lu, height %lu",
         window_width, window_height);
     return false;
   }
+  // only smooth when actually scaling, so that nothing gets blurred at full resolution
+  texture.setSmooth(render_smooth && render_scale < 1);
   reset_all(texture);
+  present_pending = true;
 
   if (horiz) {
-    handle_resize_horiz();
+    return handle_resize_axis<HorizAxis>(texture);
   } else {
-    handle_resize_vert();
+    return handle_resize_axis<VertAxis>(texture);
   }
-  return true;
 }
 
-void soundview::DisplayImpl::handle_resize_horiz() {
-  // analyzer on right edge, with voiceprint getting the remainder
-  analyzer_thickness = 0.01 * analyzer_thickness_pct * window_width;
+template <typename Axis>
+bool soundview::DisplayImpl::handle_resize_axis(sf::RenderTexture& texture) {
+  // analyzer at the end of the time axis, with voiceprint getting the remainder
+  analyzer_thickness = 0.01 * analyzer_thickness_pct * Axis::time_len(window_width, window_height);
 
-  // Update scaled bucket widths to window height
-  if (window_height != bucket_cached_view_size) {
-    bucket_cached_view_size = window_height;
+  // Update scaled bucket widths to the length of the bucket axis
+  const size_t axis_len = Axis::bucket_len(window_width, window_height);
+  if (axis_len != bucket_cached_view_size) {
+    bucket_cached_view_size = axis_len;
     if (bucket_widths.empty()) {
       bucket_widths.resize(bucket_count);
     }
@@ -559,37 +699,170 @@ void soundview::DisplayImpl::handle_resize_horiz() {
     // Scaled formula:
     //   pxlen = (bucket_count - data_i)^scale * (scale + 1) / bucket_count^(scale + 1)
     const double multiplier =
-      window_height * (bucket_bass_exaggeration + 1)
+      axis_len * (bucket_bass_exaggeration + 1)
       / pow(bucket_count, bucket_bass_exaggeration + 1);
     for (size_t data_i = 0; data_i < bucket_count; ++data_i) {
       bucket_widths[data_i] = pow(bucket_count - data_i, bucket_bass_exaggeration) * multiplier;
     }
   }
 
+  // Rebuild column and analyzer quads against the updated sizes. Columns are built starting at
+  // zero along the time axis, and analyzer bars with zero length.
+  const float column_end = Axis::time_step(voiceprint_scroll_rate);
+  const float analyzer_origin = Axis::time_origin(
+      Axis::analyzer_rect(window_width, window_height, analyzer_thickness));
+  double bucket_start = 0;
+  for (size_t i = 0; i < bucket_count; ++i) {
+    sf::Vertex* quad = &column_vertices[i * 4];
+    sf::Vertex* analyzer_quad = &analyzer_vertices[i * 4];
+    const double bucket_end = bucket_start + bucket_widths[i];
+    Axis::set_time_span(quad, 0, column_end);
+    Axis::set_bucket_span(quad, axis_len, bucket_start, bucket_end);
+    Axis::set_time_span(analyzer_quad, analyzer_origin, analyzer_origin);
+    Axis::set_bucket_span(analyzer_quad, axis_len, bucket_start, bucket_end);
+    bucket_start = bucket_end;
+  }
+
+  if (analyzer_thickness_pct < 100) {
+    update_axis_buckets<Axis>();
+    if (voiceprint_pixels && !handle_resize_pixels<Axis>()) {
+      return false;
+    }
+    // the old voiceprint went away with the old texture, so redraw it from history
+    return redraw_voiceprint_axis<Axis>(texture);
+  }
+  return true;
 }
 
-void soundview::DisplayImpl::handle_resize_vert() {
-  // analyzer on top edge, with voiceprint getting the remainder
-  analyzer_thickness = 0.01 * analyzer_thickness_pct * window_height;
+template <typename Axis>
+bool soundview::DisplayImpl::handle_resize_pixels() {
+  const sf::IntRect voiceprint =
+    Axis::voiceprint_rect(window_width, window_height, analyzer_thickness);
+  if (!voiceprint_texture.create(voiceprint.width, voiceprint.height)) {
+    ERROR("Failed to create voiceprint texture of width %d, height %d",
+        voiceprint.width, voiceprint.height);
+    return false;
+  }
+  // repeating lets the ring of columns be drawn in one pass, starting from voiceprint_edge
+  voiceprint_texture.setRepeated(true);
+  voiceprint_texture.setSmooth(render_smooth && render_scale < 1);
+  column_pixels.resize(
+      Axis::bucket_len(voiceprint.width, voiceprint.height) * voiceprint_scroll_rate);
+  return true;
+}
 
-  // Update scaled bucket widths to window width
-  if (window_width != bucket_cached_view_size) {
-    bucket_cached_view_size = window_width;
-    if (bucket_widths.empty()) {
-      bucket_widths.resize(bucket_count);
+template <typename Axis>
+void soundview::DisplayImpl::update_axis_buckets() {
+  // map each pixel along the bucket axis to the range of buckets whose centers fall within it.
+  // when buckets are wider than pixels, use the one bucket which covers the pixel's center.
+  const size_t axis_len = Axis::bucket_len(window_width, window_height);
+  axis_colors.resize(axis_len);
+  axis_bucket_start.resize(axis_len);
+  axis_bucket_end.resize(axis_len);
+  size_t bucket = 0;
+  double bucket_start = 0;
+  for (size_t px = 0; px < axis_len; ++px) {
+    // skip buckets whose centers are before this pixel
+    while (bucket < bucket_count && bucket_start + (bucket_widths[bucket] / 2) < px) {
+      bucket_start += bucket_widths[bucket];
+      ++bucket;
+    }
+    size_t end = bucket;
+    double end_start = bucket_start;
+    while (end < bucket_count && end_start + (bucket_widths[end] / 2) < px + 1) {
+      end_start += bucket_widths[end];
+      ++end;
+    }
+    if (end == bucket) {
+      // no bucket centers within this pixel: use the bucket covering this pixel's center
+      axis_bucket_start[px] = (bucket > 0 && bucket_start > px + 0.5) ? bucket - 1 : bucket;
+      axis_bucket_end[px] = std::min(axis_bucket_start[px] + 1, bucket_count);
+    } else {
+      axis_bucket_start[px] = bucket;
+      axis_bucket_end[px] = end;
     }
+  }
 
-    // Formula:
-    //   pxlen = (bucket_count - data_i)^scale / bucket_count^scale
-    // Integrate over data_i from 0 to bucket_count:
-    //   sum(pxlen) = bucket_count / (scale + 1)
-    // Scaled formula:
-    //   pxlen = (bucket_count - data_i)^scale * (scale + 1) / bucket_count^(scale + 1)
-    const double multiplier =
-      window_width * (bucket_bass_exaggeration + 1)
-      / pow(bucket_count, bucket_bass_exaggeration + 1);
-    for (size_t data_i = 0; data_i < bucket_count; ++data_i) {
-      bucket_widths[data_i] = pow(bucket_count - data_i, bucket_bass_exaggeration) * multiplier;
+  // and the reverse: the first pixel showing each bucket, for expanding reduced frames
+  bucket_pixel.assign(bucket_count, axis_len);
+  for (size_t px = axis_len; px-- > 0;) {
+    for (size_t i = axis_bucket_start[px]; i < axis_bucket_end[px]; ++i) {
+      bucket_pixel[i] = px;
     }
   }
+  for (size_t i = 0; i < bucket_count; ++i) {
+    if (bucket_pixel[i] == axis_len) {
+      // not shown on any pixel (past the end of the axis): use the nearest one before it
+      bucket_pixel[i] = (i == 0) ? 0 : bucket_pixel[i - 1];
+    }
+  }
+  pixel_levels.resize(axis_len);
+
+  // let the transformer do the reduction from here on
+  pixel_map_generation = reducer.publish(axis_bucket_start, axis_bucket_end);
+}
+
+bool soundview::DisplayImpl::redraw_voiceprint(sf::RenderTexture& texture) {
+  if (horiz) {
+    return redraw_voiceprint_axis<HorizAxis>(texture);
+  } else {
+    return redraw_voiceprint_axis<VertAxis>(texture);
+  }
+}
+
+template <typename Axis>
+bool soundview::DisplayImpl::redraw_voiceprint_axis(sf::RenderTexture& texture) {
+  // lay out as many columns as fit, from the live history or the current scrollback position,
+  // oldest first along the time axis and leaving voiceprint_edge just after the newest.
+  const sf::IntRect voiceprint =
+    Axis::voiceprint_rect(window_width, window_height, analyzer_thickness);
+  const size_t voiceprint_len = Axis::time_len(voiceprint.width, voiceprint.height);
+  const size_t thickness = voiceprint_scroll_rate;
+  const size_t fit = voiceprint_len / thickness;
+  size_t offset = 0, count;
+  if (scrollback) {
+    // don't scroll back further than what's available at this level, unless it doesn't fill
+    // the voiceprint anyway
+    const size_t available = scrollback_size(scrollback_level);
+    offset = std::min(scrollback_age >> scrollback_level, available > fit ? available - fit : 0);
+    scrollback_age = offset << scrollback_level;
+    count = std::min(available - offset, fit);
+  } else {
+    count = std::min(history.size(), fit);
+  }
+  if (count == 0 && !voiceprint_pixels) {
+    // nothing to add to the render texture, which is already black
+    voiceprint_edge = 0;
+    return true;
+  }
+
+  // rasterize everything into one image, then upload it in a single pass
+  const sf::IntRect image(0, 0, voiceprint.width, voiceprint.height);
+  std::vector<rgba_t> pixels(image.width * image.height, HSL::pack(sf::Color::Black));
+  for (size_t age = 0; age < count; ++age) {
+    update_axis_colors(scrollback_level == 0
+        ? history.get(offset + age)
+        : pyramid.get(scrollback_level, offset + age, scrollback_stat));
+    const sf::IntRect strip =
+      Axis::time_rect(image, (count - 1 - age) * thickness, (count - age) * thickness);
+    Axis::write_strip(axis_colors.data(), axis_colors.size(),
+        pixels.data() + (strip.top * image.width) + strip.left, image.width, thickness);
+  }
+  voiceprint_edge = (count * thickness) % voiceprint_len;
+
+  if (voiceprint_pixels) {
+    voiceprint_texture.update(reinterpret_cast<const sf::Uint8*>(pixels.data()));
+  } else {
+    sf::Texture history_texture;
+    if (!history_texture.create(image.width, image.height)) {
+      ERROR("Failed to create history texture of width %d, height %d",
+          image.width, image.height);
+      return false;
+    }
+    history_texture.update(reinterpret_cast<const sf::Uint8*>(pixels.data()));
+    sf::Sprite sprite(history_texture);
+    sprite.setPosition(voiceprint.left, voiceprint.top);
+    texture.draw(sprite);
+  }
+  return true;
 }
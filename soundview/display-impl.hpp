@@ -16,27 +16,49 @@
 
 #pragma once
 
+#include <atomic>
+#include <chrono>
 #include <condition_variable>
 #include <functional>
+#include <mutex>
 #include <vector>
 
 #include <SFML/Graphics/RenderTexture.hpp>
 #include <SFML/Graphics/RenderWindow.hpp>
-
-#include "soundview/double-buffer.hpp"
+#include <SFML/Graphics/Texture.hpp>
+#include <SFML/Graphics/VertexArray.hpp>
+
+#include "soundview/column-history.hpp"
+#include "soundview/column-pyramid.hpp"
+#include "soundview/frame-pool.hpp"
+#include "soundview/frame-reducer.hpp"
+#include "soundview/frame-scheduler.hpp"
 #include "soundview/hsl.hpp"
 #include "soundview/options.hpp"
+#include "soundview/spsc-queue.hpp"
 
 namespace soundview {
 
   typedef std::function<bool()> reload_device_func_t;
+  typedef std::function<bool()> reload_status_func_t;
 
   /**
    * Underlying implementation of displaying data to the screen.
    */
   class DisplayImpl {
    public:
-    DisplayImpl(const Options& options, reload_device_func_t reload_device_func);
+    /**
+     * reload_device_func starts switching to a new device in the background, while
+     * reload_status_func returns whether a switch is still in progress.
+     */
+    DisplayImpl(const Options& options, FramePool& pool, FrameReducer& reducer,
+        reload_device_func_t reload_device_func, reload_status_func_t reload_status_func);
+
+    /**
+     * Returns any frames which haven't been displayed to the pool. Whatever is calling
+     * append_frames() must have stopped by now, since this releases frames from the display thread.
+     */
+    virtual ~DisplayImpl();
 
     /**
      * The main display thread. Displays freq data provided by append_freq_data() and responds to
@@ -47,9 +69,10 @@ namespace soundview {
     // The following are all called on a separate thread from run():
 
     /**
-     * Adds audio data to be displayed.
+     * Adds frames of audio data to be displayed. The frames are returned to the pool once they've
+     * been displayed.
      */
-    bool append_freq_data(const std::vector<double>& freq_data);
+    bool append_frames(const std::vector<Frame*>& frames);
 
     /**
      * Returns whether the display is still running.
@@ -65,15 +88,38 @@ namespace soundview {
     bool handle_user_events(sf::RenderWindow& window);
 
     void draw_freq_data(sf::RenderWindow& window, sf::RenderTexture& texture,
-        std::vector<std::vector<double> >& freq_sets);
-    void draw_freq_data_horiz(sf::RenderWindow& window, sf::RenderTexture& texture,
-        std::vector<std::vector<double> >& freq_sets);
-    void draw_freq_data_vert(sf::RenderWindow& window, sf::RenderTexture& texture,
-        std::vector<std::vector<double> >& freq_sets);
+        const std::vector<const Frame*>& freq_sets);
+    // the draw and resize paths are specialized for each orientation at compile time, with an
+    // axis policy from display-axis.hpp. the policy is chosen once per frame based on 'horiz'.
+    template <typename Axis>
+    void draw_freq_data_axis(sf::RenderWindow& window, sf::RenderTexture& texture,
+        const std::vector<const Frame*>& freq_sets);
+    bool frame_stale(const Frame* frame) const;
+    const uint8_t* quantize_column(const Frame* frame);
+    void update_column_colors(const Frame* frame);
+    void update_axis_colors(const uint8_t* levels);
+    template <typename Axis>
+    void draw_column_pixels(const Frame* frame);
+    template <typename Axis>
+    void upload_strip(size_t pos, size_t thickness);
+
+    void wait_for_frames(frame_clock_t::time_point deadline);
+    void wake_run();
 
     bool handle_resize(sf::RenderWindow& window, sf::RenderTexture& texture);
-    void handle_resize_horiz();
-    void handle_resize_vert();
+    template <typename Axis>
+    bool handle_resize_axis(sf::RenderTexture& texture);
+    template <typename Axis>
+    bool handle_resize_pixels();
+    template <typename Axis>
+    void update_axis_buckets();
+    bool redraw_voiceprint(sf::RenderTexture& texture);
+    template <typename Axis>
+    bool redraw_voiceprint_axis(sf::RenderTexture& texture);
+
+    size_t scrollback_size(size_t level) const;
+    void scroll(int pan, int zoom);
+    void update_title(sf::RenderWindow& window);
 
     // from options
     const size_t analyzer_thickness_pct;
@@ -83,27 +129,92 @@ namespace soundview {
     const size_t bucket_count;
     const double bucket_bass_exaggeration;
     const size_t voiceprint_scroll_rate;
+    const bool voiceprint_pixels;
+    const double render_scale;
+    const bool render_smooth;
     const double loudness_adjust_rate;
 
     const HSL hsl;
+    FramePool& pool;
+    FrameReducer& reducer;
     const reload_device_func_t reload_device_func;
+    const reload_status_func_t reload_status_func;
 
     bool horiz;
+    // whether the device is being switched in the background, as of the last check
+    bool device_switching;
     size_t analyzer_thickness;
+    // the resolution being rendered at, which is the window's size scaled by render_scale
     size_t window_width;
     size_t window_height;
     // for each bucket, the width (in px) to display for that bucket.
     std::vector<double> bucket_widths;
     size_t bucket_cached_view_size;
-    // the right edge of the voiceprint column thats being written to
+    // where the next voiceprint column will be written, along the time axis from the start of the
+    // voiceprint. the columns form a ring, so this is also just past the newest column
     size_t voiceprint_edge;
-
-    std::mutex mutex;
-
-    DoubleBuffer<std::vector<double> > buf_freqs;
+    // prebuilt quads for a single voiceprint column and for the analyzer, each drawn with a single
+    // call. only colors (and analyzer bar lengths) are updated for each frame
+    sf::VertexArray column_vertices;
+    sf::VertexArray analyzer_vertices;
+    // colors for each bucket of the quad column or the analyzer, converted together before they're
+    // copied into the vertices
+    std::vector<rgba_t> bucket_colors;
+    // values of the last analyzer frame for each bucket, expanded from pixels if it was reduced.
+    // kept for redrawing the analyzer when a newer frame is stale
+    aligned_vector<freq_t> analyzer_values;
+    size_t analyzer_len;
+    // when voiceprint_pixels is enabled, the voiceprint is kept in its own repeating texture, and
+    // new columns are written to it directly as pixels.
+    sf::Texture voiceprint_texture;
+    // buffer for pixels of the new column, before they're uploaded to voiceprint_texture
+    std::vector<rgba_t> column_pixels;
+    // for each pixel along the bucket axis: its color and the range of buckets which it shows
+    std::vector<rgba_t> axis_colors;
+    std::vector<size_t> axis_bucket_start;
+    std::vector<size_t> axis_bucket_end;
+    // for each bucket: the first pixel along the bucket axis which shows it
+    std::vector<size_t> bucket_pixel;
+    // the generation of the pixel map last published to the reducer, or 0 if frames aren't reduced
+    uint32_t pixel_map_generation;
+    // levels for each pixel along the bucket axis. valid for the last quantized frame if it had
+    // been reduced
+    aligned_vector<uint8_t> pixel_levels;
+    bool pixel_levels_valid;
+
+    // levels of recently drawn columns, for redrawing the voiceprint after a resize or rotate
+    ColumnHistory history;
+    // the last column of levels returned by quantize_column()
+    const uint8_t* prev_levels;
+    // summaries of older columns, for zooming out in scrollback
+    ColumnPyramid pyramid;
+
+    // scrollback state. while scrollback is enabled, new columns are recorded but not drawn, and
+    // the voiceprint instead shows the columns at scrollback_level ending scrollback_age original
+    // columns ago
+    bool scrollback;
+    bool scrollback_changed;
+    size_t scrollback_level;
+    size_t scrollback_age;
+    ColumnPyramid::Stat scrollback_stat;
+    // whether the window needs to be redrawn even if there aren't any new frames
+    bool present_pending;
+
+    // frames passed from the audio thread to run(). has room for every frame in the pool
+    SpscQueue<Frame*> frame_queue;
+    // decides which frames are drawn as which columns, to keep the scroll rate steady
+    FrameScheduler scheduler;
     double device_max_freq_val;
 
-    bool shutdown;
+    // when run() has nothing to draw, it sleeps on wake_cond until frames arrive, the next column
+    // is due, or wake_interval has passed, whichever comes first. the audio thread only takes
+    // wake_mutex to notify run() when 'waiting' says that it's asleep.
+    const std::chrono::microseconds wake_interval;
+    std::mutex wake_mutex;
+    std::condition_variable wake_cond;
+    std::atomic<bool> waiting;
+
+    std::atomic<bool> shutdown;
   };
 
 }
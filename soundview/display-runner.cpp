@@ -19,20 +19,26 @@
 #include "soundview/display-impl.hpp"
 #include "soundview/hsl.hpp"
 
-soundview::DisplayRunner::DisplayRunner(const Options& options, reload_device_func_t reload_device_func)
-  : display_impl(new DisplayImpl(options, reload_device_func)) { }
+soundview::DisplayRunner::DisplayRunner(
+    const Options& options, FramePool& pool, FrameReducer& reducer,
+    reload_device_func_t reload_device_func, reload_status_func_t reload_status_func)
+  : display_impl(new DisplayImpl(
+            options, pool, reducer, reload_device_func, reload_status_func)) { }
 
 soundview::DisplayRunner::~DisplayRunner() { }
 
-bool soundview::DisplayRunner::append_freq_data(const std::vector<double>& freq_data) {
-  return (display_impl) ? display_impl->append_freq_data(freq_data) : false;
+bool soundview::DisplayRunner::append_frames(const std::vector<Frame*>& frames) {
+  // after the display has exited, frames are still queued, and are returned to the pool when the
+  // display is destroyed. releasing them here would make this a second thread releasing frames
+  return display_impl->append_frames(frames);
 }
 
 bool soundview::DisplayRunner::check_running() {
-  return (bool) display_impl;
+  return display_impl->check_running();
 }
 
 void soundview::DisplayRunner::run() {
   display_impl->run();
-  display_impl.reset();
+  // run() also returns when the window is closed, so make sure check_running() reflects that
+  display_impl->exit();
 }
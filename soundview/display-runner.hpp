@@ -22,26 +22,33 @@
 #include <vector>
 
 #include "soundview/config.hpp"
+#include "soundview/frame-pool.hpp"
+#include "soundview/frame-reducer.hpp"
 #include "soundview/options.hpp"
 
 namespace soundview {
   class DisplayImpl;
 
   typedef std::function<bool()> reload_device_func_t;
+  typedef std::function<bool()> reload_status_func_t;
 
   /**
    * Wrapper for accepting frequency data and displaying it.
    * Mainly handles threading for an underlying DisplayImpl.
+   * Whatever calls append_frames() must be stopped before this is destroyed, as any frames which
+   * haven't been displayed are returned to the pool from the destroying thread.
    */
   class LIB_API DisplayRunner {
    public:
-    DisplayRunner(const Options& options, reload_device_func_t reload_device_func);
+    DisplayRunner(const Options& options, FramePool& pool, FrameReducer& reducer,
+        reload_device_func_t reload_device_func, reload_status_func_t reload_status_func);
     virtual ~DisplayRunner();
 
     /**
-     * Appends freq data to be displayed, or returns false if not ready yet.
+     * Appends frames to be displayed, or returns false if not ready yet. Takes ownership of the
+     * frames, which are returned to the pool once they have been displayed.
      */
-    bool append_freq_data(const std::vector<double>& freq_data);
+    bool append_frames(const std::vector<Frame*>& frames);
 
     /**
      * Returns whether the display is still running. False = user exited.
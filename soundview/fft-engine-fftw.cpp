@@ -0,0 +1,206 @@
+/* SoundView - Eye candy for your music
+ * Copyright (C) 2016 Nicholas Parker
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>. */
+
+
+#include "soundview/config.hpp"
+
+#ifdef SOUNDVIEW_FFTW
+
+#include <chrono>
+#include <sstream>
+#include <fftw3.h>
+
+#include "soundview/fft-engine-fftw.hpp"
+#include "soundview/state-file.hpp"
+
+namespace {
+  /**
+   * Maps a scalar type to the matching FFTW API: fftw_* for double, fftwf_* for float.
+   */
+  template <typename T> struct FftwApi;
+
+  template <> struct FftwApi<double> {
+    typedef fftw_complex complex_t;
+    static const char* name() { return "double"; }
+    static fftw_plan plan_many_dft_r2c(int n, int howmany,
+        double* in, int idist, fftw_complex* out, int odist, unsigned flags) {
+      return fftw_plan_many_dft_r2c(1, &n, howmany, in, NULL, 1, idist, out, NULL, 1, odist, flags);
+    }
+    static void execute(fftw_plan plan) { fftw_execute(plan); }
+    static void execute(fftw_plan plan, double* in, fftw_complex* out) {
+      fftw_execute_dft_r2c(plan, in, out);
+    }
+    static int alignment_of(double* p) { return fftw_alignment_of(p); }
+    static void destroy_plan(fftw_plan plan) { fftw_destroy_plan(plan); }
+    static void cleanup() { fftw_cleanup(); }
+#ifdef SOUNDVIEW_FFTW_THREADS
+    static void init_threads() { fftw_init_threads(); }
+    static void plan_with_nthreads(int n) { fftw_plan_with_nthreads(n); }
+    static void cleanup_threads() { fftw_cleanup_threads(); }
+#endif
+    static bool import_wisdom(const char* path) { return fftw_import_wisdom_from_filename(path); }
+    static bool export_wisdom(const char* path) { return fftw_export_wisdom_to_filename(path); }
+  };
+
+#ifdef SOUNDVIEW_FFTW_FLOAT
+  template <> struct FftwApi<float> {
+    typedef fftwf_complex complex_t;
+    static const char* name() { return "float"; }
+    static fftwf_plan plan_many_dft_r2c(int n, int howmany,
+        float* in, int idist, fftwf_complex* out, int odist, unsigned flags) {
+      return fftwf_plan_many_dft_r2c(1, &n, howmany, in, NULL, 1, idist, out, NULL, 1, odist, flags);
+    }
+    static void execute(fftwf_plan plan) { fftwf_execute(plan); }
+    static void execute(fftwf_plan plan, float* in, fftwf_complex* out) {
+      fftwf_execute_dft_r2c(plan, in, out);
+    }
+    static int alignment_of(float* p) { return fftwf_alignment_of(p); }
+    static void destroy_plan(fftwf_plan plan) { fftwf_destroy_plan(plan); }
+    static void cleanup() { fftwf_cleanup(); }
+#ifdef SOUNDVIEW_FFTW_THREADS
+    static void init_threads() { fftwf_init_threads(); }
+    static void plan_with_nthreads(int n) { fftwf_plan_with_nthreads(n); }
+    static void cleanup_threads() { fftwf_cleanup_threads(); }
+#endif
+    static bool import_wisdom(const char* path) { return fftwf_import_wisdom_from_filename(path); }
+    static bool export_wisdom(const char* path) { return fftwf_export_wisdom_to_filename(path); }
+  };
+#endif
+
+  unsigned get_planner_flags(const std::string& planner) {
+    if (planner == "estimate") {
+      return FFTW_ESTIMATE;
+    } else if (planner == "patient") {
+      return FFTW_PATIENT;
+    } else if (planner == "exhaustive") {
+      return FFTW_EXHAUSTIVE;
+    } else if (planner != "measure") {
+      ERROR("Unknown planner '%s', using measure", planner.c_str());
+    }
+    return FFTW_MEASURE;
+  }
+
+  /**
+   * Creates a plan for 'howmany' FFTs of length 'n' from 'in' to 'out'. Any wisdom from earlier
+   * runs is loaded from the state dir before planning, and the resulting wisdom is saved back
+   * immediately afterwards, so that the cost of the slower planners is only paid once per machine.
+   */
+  template <typename T>
+  typename soundview::FftwPlan<T>::type plan_with_wisdom(const soundview::Options& options,
+      size_t n, size_t howmany, size_t threads,
+      T* in, size_t in_dist, std::complex<T>* out, size_t out_dist) {
+    // wisdom is per-precision, and keeping a file per size avoids unbounded growth
+    std::ostringstream oss;
+    oss << "fftw-wisdom-" << FftwApi<T>::name() << "-" << n << ".dat";
+    const std::string wisdom_path = soundview::state_file_path(options.state_dir(), oss.str());
+    if (!wisdom_path.empty() && FftwApi<T>::import_wisdom(wisdom_path.c_str())) {
+      DEBUG("Loaded FFT wisdom from %s", wisdom_path.c_str());
+    }
+
+#ifdef SOUNDVIEW_FFTW_THREADS
+    // applies to every plan created after it, so the single-frame plan explicitly asks for one
+    FftwApi<T>::plan_with_nthreads(threads);
+#else
+    (void) threads;
+#endif
+    auto start = std::chrono::steady_clock::now();
+    typename soundview::FftwPlan<T>::type plan = FftwApi<T>::plan_many_dft_r2c(
+        n, howmany,
+        in, in_dist,
+        reinterpret_cast<typename FftwApi<T>::complex_t*>(out), out_dist,
+        get_planner_flags(options.fft_planner()));
+    DEBUG("Planned %lux %lu-point FFT in %ldms", howmany, n,
+        (long) std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::steady_clock::now() - start).count());
+
+    if (plan && !wisdom_path.empty() && !FftwApi<T>::export_wisdom(wisdom_path.c_str())) {
+      ERROR("Failed to save FFT wisdom to %s", wisdom_path.c_str());
+    }
+    return plan;
+  }
+}
+
+template <typename T>
+soundview::FftwEngine<T>::FftwEngine(const Options& options, const FftBuffers<T>& buffers)
+  : buffers(buffers),
+    threads(options.fft_threads()),
+    plan(NULL),
+    batch_plan(NULL) {
+#ifdef SOUNDVIEW_FFTW_THREADS
+  // fftw requires this before any other call, including the wisdom import when planning. done even
+  // with one thread, since every plan sets its thread count. paired with cleanup_threads() below
+  FftwApi<T>::init_threads();
+#else
+  if (threads > 1) {
+    ERROR("Threaded FFT support wasn't included in this build, using 1 thread");
+  }
+#endif
+  plan = plan_with_wisdom(options, buffers.len, 1, 1,
+      buffers.in, buffers.in_dist, buffers.out, buffers.out_dist);
+  if (!plan) {
+    ERROR("FFT Plan construction failed");
+  }
+  if (buffers.frames > 1) {
+    batch_plan = plan_with_wisdom(options, buffers.len, buffers.frames, threads,
+        buffers.in, buffers.in_dist, buffers.out, buffers.out_dist);
+    if (!batch_plan) {
+      ERROR("Batch FFT Plan construction failed, frames will be transformed individually");
+    }
+  }
+  // FFTW only picks its SIMD codelets when the arrays it plans against are aligned for them
+  if (FftwApi<T>::alignment_of(buffers.in) == 0
+      && FftwApi<T>::alignment_of(reinterpret_cast<T*>(buffers.out)) == 0) {
+    DEBUG("FFT buffers are SIMD-aligned: plans may use FFTW's SIMD codelets");
+  } else {
+    DEBUG("FFT buffers aren't SIMD-aligned: plans are limited to FFTW's scalar codelets");
+  }
+}
+
+template <typename T>
+soundview::FftwEngine<T>::~FftwEngine() {
+  if (batch_plan != NULL) {
+    FftwApi<T>::destroy_plan(batch_plan);
+  }
+  if (plan != NULL) {
+    FftwApi<T>::destroy_plan(plan);
+  }
+#ifdef SOUNDVIEW_FFTW_THREADS
+  // also does everything that cleanup() does
+  FftwApi<T>::cleanup_threads();
+#else
+  FftwApi<T>::cleanup();
+#endif
+}
+
+template <typename T>
+void soundview::FftwEngine<T>::transform(size_t frames) {
+  if (frames == buffers.frames && batch_plan != NULL) {
+    FftwApi<T>::execute(batch_plan); // converts all of in => out
+  } else {
+    for (size_t f = 0; f < frames; ++f) {
+      FftwApi<T>::execute(plan,
+          buffers.in + (f * buffers.in_dist),
+          reinterpret_cast<typename FftwApi<T>::complex_t*>(buffers.out + (f * buffers.out_dist)));
+    }
+  }
+}
+
+template class soundview::FftwEngine<double>;
+#ifdef SOUNDVIEW_FFTW_FLOAT
+template class soundview::FftwEngine<float>;
+#endif
+
+#endif
@@ -0,0 +1,58 @@
+/* SoundView - Eye candy for your music
+ * Copyright (C) 2016 Nicholas Parker
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>. */
+
+
+#pragma once
+
+#include "soundview/fft-engine.hpp"
+
+struct fftw_plan_s;
+struct fftwf_plan_s;
+
+namespace soundview {
+
+  /**
+   * Maps a scalar type to its FFTW plan type: fftw_* for double, fftwf_* for float.
+   */
+  template <typename T> struct FftwPlan;
+  template <> struct FftwPlan<double> { typedef fftw_plan_s* type; };
+  template <> struct FftwPlan<float> { typedef fftwf_plan_s* type; };
+
+  /**
+   * Runs FFTs with FFTW. Full batches are transformed with a single plan, which may use multiple
+   * threads, while partial batches reuse a single-frame plan against each frame. Plans are
+   * created with the --planner flags, and the resulting wisdom is kept in the state dir.
+   * Only built with SOUNDVIEW_FFTW, and for float with SOUNDVIEW_FFTW_FLOAT.
+   */
+  template <typename T>
+  class FftwEngine : public FftEngine<T> {
+   public:
+    FftwEngine(const Options& options, const FftBuffers<T>& buffers);
+    virtual ~FftwEngine();
+
+    void transform(size_t frames);
+
+   private:
+    const FftBuffers<T> buffers;
+    // number of threads for fftw to use when transforming a full batch
+    const size_t threads;
+    // transforms a single frame, used for partial batches
+    typename FftwPlan<T>::type plan;
+    // transforms a full batch of frames, or NULL if there's only room for one frame
+    typename FftwPlan<T>::type batch_plan;
+  };
+
+}
@@ -0,0 +1,114 @@
+/* SoundView - Eye candy for your music
+ * Copyright (C) 2016 Nicholas Parker
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>. */
+
+
+#include "soundview/config.hpp"
+#include "soundview/fft-engine.hpp"
+#include "soundview/fft-radix2.hpp"
+
+#ifdef SOUNDVIEW_FFTW
+#include "soundview/fft-engine-fftw.hpp"
+#endif
+
+namespace {
+  /**
+   * Runs the bundled Radix2Fft against each frame.
+   */
+  template <typename T>
+  class Radix2Engine : public soundview::FftEngine<T> {
+   public:
+    Radix2Engine(const soundview::FftBuffers<T>& buffers)
+      : buffers(buffers),
+        fft(buffers.len) { }
+
+    void transform(size_t frames) {
+      for (size_t f = 0; f < frames; ++f) {
+        fft.transform(buffers.in + (f * buffers.in_dist), buffers.out + (f * buffers.out_dist));
+      }
+    }
+
+   private:
+    const soundview::FftBuffers<T> buffers;
+    soundview::Radix2Fft<T> fft;
+  };
+
+  /**
+   * Runs the bundled fixed-point Q15Fft against each frame.
+   */
+  class Q15Engine : public soundview::FftEngine<int16_t> {
+   public:
+    Q15Engine(const soundview::FftBuffers<int16_t>& buffers)
+      : buffers(buffers),
+        fft(buffers.len) { }
+
+    void transform(size_t frames) {
+      for (size_t f = 0; f < frames; ++f) {
+        fft.transform(buffers.in + (f * buffers.in_dist), buffers.out + (f * buffers.out_dist));
+      }
+    }
+
+   private:
+    const soundview::FftBuffers<int16_t> buffers;
+    soundview::Q15Fft fft;
+  };
+
+  void check_threads(const soundview::Options& options) {
+    if (options.fft_threads() > 1) {
+      ERROR("Only the fftw engine supports --fft-threads, using 1 thread");
+    }
+  }
+}
+
+bool soundview::fft_engine_mixed_radix(const Options& options) {
+  return options.fft_engine() == "fftw";
+}
+
+namespace soundview {
+
+  template <>
+  FftEngine<double>* new_fft_engine(const Options& options, const FftBuffers<double>& buffers) {
+#ifdef SOUNDVIEW_FFTW
+    if (options.fft_engine() == "fftw") {
+      DEBUG("Using FFTW engine");
+      return new FftwEngine<double>(options, buffers);
+    }
+#endif
+    DEBUG("Using builtin FFT engine");
+    check_threads(options);
+    return new Radix2Engine<double>(buffers);
+  }
+
+  template <>
+  FftEngine<float>* new_fft_engine(const Options& options, const FftBuffers<float>& buffers) {
+#ifdef SOUNDVIEW_FFTW_FLOAT
+    if (options.fft_engine() == "fftw") {
+      DEBUG("Using FFTW engine");
+      return new FftwEngine<float>(options, buffers);
+    }
+#endif
+    DEBUG("Using builtin FFT engine");
+    check_threads(options);
+    return new Radix2Engine<float>(buffers);
+  }
+
+  template <>
+  FftEngine<int16_t>* new_fft_engine(const Options& options, const FftBuffers<int16_t>& buffers) {
+    DEBUG("Using Q15 FFT engine");
+    check_threads(options);
+    return new Q15Engine(buffers);
+  }
+
+}
@@ -0,0 +1,87 @@
+/* SoundView - Eye candy for your music
+ * Copyright (C) 2016 Nicholas Parker
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>. */
+
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <complex>
+
+#include "soundview/fft-q15.hpp"
+#include "soundview/options.hpp"
+#include "soundview/simd-kernels.hpp"
+
+namespace soundview {
+
+  /**
+   * Maps a sample type to the type of the FFT's output: std::complex for floating point, or
+   * Q15Complex for 16-bit fixed point.
+   */
+  template <typename T> struct FftComplex { typedef std::complex<T> type; };
+  template <> struct FftComplex<int16_t> { typedef Q15Complex type; };
+
+  /**
+   * The buffers which an FftEngine transforms between: up to 'frames' frames of 'len' samples
+   * each, 'in_dist' apart in 'in', and the same number of frames of 'len'/2+1 bins each,
+   * 'out_dist' apart in 'out'. Every frame has the same alignment as the first.
+   */
+  template <typename T>
+  struct FftBuffers {
+    size_t len;
+    size_t frames;
+    T* in;
+    size_t in_dist;
+    typename FftComplex<T>::type* out;
+    size_t out_dist;
+  };
+
+  /**
+   * Interface for running real-to-complex FFTs. An engine is created for a fixed set of buffers,
+   * which lets engines like FFTW plan ahead for them.
+   */
+  template <typename T>
+  class FftEngine {
+   public:
+    virtual ~FftEngine() { }
+
+    /**
+     * Transforms the first 'frames' frames of the engine's buffers.
+     */
+    virtual void transform(size_t frames) = 0;
+  };
+
+  /**
+   * Returns whether the engine picked by --fft-engine is fast for any length which is a product of
+   * 2, 3 and 5. Otherwise it only supports powers of two.
+   */
+  bool fft_engine_mixed_radix(const Options& options);
+
+  /**
+   * Creates the engine picked by --fft-engine for the provided buffers: FFTW or the bundled
+   * Radix2Fft for floating point, or Q15Fft for 16-bit samples.
+   */
+  template <typename T>
+  FftEngine<T>* new_fft_engine(const Options& options, const FftBuffers<T>& buffers);
+
+  /**
+   * Magnitudes of Q15 output, alongside the floating point overloads in simd-kernels.hpp.
+   */
+  inline void simd_magnitudes(const Q15Complex* in, size_t len, freq_t* out) {
+    simd_kernels().magnitudes_q15(reinterpret_cast<const int16_t*>(in), len, out);
+  }
+
+}
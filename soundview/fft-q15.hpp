@@ -0,0 +1,145 @@
+/* SoundView - Eye candy for your music
+ * Copyright (C) 2016 Nicholas Parker
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>. */
+
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <math.h>
+#include <vector>
+
+namespace soundview {
+
+  /**
+   * A complex value in Q15 fixed point, where 32767 is just under 1.
+   */
+  struct Q15Complex {
+    int16_t re;
+    int16_t im;
+  };
+
+  /**
+   * A fixed-point FFT of 16-bit samples, for power-of-two lengths. All arithmetic is done on
+   * integers, which is much faster than floating point on low-power CPUs. Samples from the device
+   * are used as they are, without any conversion.
+   *
+   * Like Radix2Fft, the samples are packed into complex values for a half-length radix-2 FFT, and
+   * then split into the bins of the real transform. Every stage halves its results so that they
+   * can't overflow, which leaves the output scaled by 1/(2*len) relative to a floating-point FFT.
+   * Quiet frequencies in long transforms lose precision as a result, but the display only shows
+   * values relative to the loudest ones.
+   */
+  class Q15Fft {
+   public:
+    /**
+     * Prepares for transforms of 'len' samples, which must be a power of two of at least 4.
+     */
+    explicit Q15Fft(size_t len)
+      : half(len / 2),
+        bitrev(half),
+        twiddles(half / 2),
+        split(half + 1),
+        work(half) {
+      const double two_pi = 6.28318530717958647692;
+      size_t bits = 0;
+      while (((size_t)1 << bits) < half) {
+        ++bits;
+      }
+      for (size_t i = 0; i < half; ++i) {
+        size_t rev = 0;
+        for (size_t b = 0; b < bits; ++b) {
+          if (i & ((size_t)1 << b)) {
+            rev |= (size_t)1 << (bits - 1 - b);
+          }
+        }
+        bitrev[i] = rev;
+      }
+      for (size_t k = 0; k < twiddles.size(); ++k) {
+        twiddles[k] = to_q15(cos(two_pi * k / half), -sin(two_pi * k / half));
+      }
+      for (size_t k = 0; k < split.size(); ++k) {
+        split[k] = to_q15(cos(two_pi * k / len), -sin(two_pi * k / len));
+      }
+    }
+
+    /**
+     * Transforms 'len' samples from 'in' into 'len'/2+1 bins in 'out', scaled by 1/(2*len).
+     */
+    void transform(const int16_t* in, Q15Complex* out) {
+      // pack pairs of samples as complex values, halved so that the magnitude of each value is
+      // within range. the butterflies and the split never increase the largest magnitude
+      for (size_t m = 0; m < half; ++m) {
+        Q15Complex& z = work[bitrev[m]];
+        z.re = in[2 * m] >> 1;
+        z.im = in[2 * m + 1] >> 1;
+      }
+      for (size_t span = 1; span < half; span *= 2) {
+        const size_t stride = half / (2 * span);
+        for (size_t start = 0; start < half; start += 2 * span) {
+          Q15Complex* a = work.data() + start;
+          Q15Complex* b = a + span;
+          for (size_t j = 0; j < span; ++j) {
+            int32_t t_re, t_im;
+            mul(b[j], twiddles[j * stride], t_re, t_im);
+            b[j].re = saturate((a[j].re - t_re) >> 1);
+            b[j].im = saturate((a[j].im - t_im) >> 1);
+            a[j].re = saturate((a[j].re + t_re) >> 1);
+            a[j].im = saturate((a[j].im + t_im) >> 1);
+          }
+        }
+      }
+      for (size_t k = 0; k <= half; ++k) {
+        const Q15Complex& z = work[(k == half) ? 0 : k];
+        const Q15Complex& zc = work[(k == 0) ? 0 : half - k];
+        // even = (z + conj(zc)) / 2, odd = (z - conj(zc)) / 2i
+        const int32_t even_re = (z.re + zc.re) >> 1, even_im = (z.im - zc.im) >> 1;
+        Q15Complex odd;
+        odd.re = saturate((z.im + zc.im) >> 1);
+        odd.im = saturate((zc.re - z.re) >> 1);
+        int32_t t_re, t_im;
+        mul(odd, split[k], t_re, t_im);
+        out[k].re = saturate((even_re + t_re) >> 1);
+        out[k].im = saturate((even_im + t_im) >> 1);
+      }
+    }
+
+   private:
+    static Q15Complex to_q15(double re, double im) {
+      Q15Complex c;
+      c.re = saturate((int32_t)lround(re * 32767));
+      c.im = saturate((int32_t)lround(im * 32767));
+      return c;
+    }
+
+    static int16_t saturate(int32_t val) {
+      return (val > 32767) ? 32767 : ((val < -32768) ? -32768 : val);
+    }
+
+    // multiplies a value by a Q15 twiddle, with rounding
+    static void mul(const Q15Complex& a, const Q15Complex& w, int32_t& re, int32_t& im) {
+      re = ((int32_t)a.re * w.re - (int32_t)a.im * w.im + (1 << 14)) >> 15;
+      im = ((int32_t)a.re * w.im + (int32_t)a.im * w.re + (1 << 14)) >> 15;
+    }
+
+    const size_t half;
+    std::vector<size_t> bitrev;
+    std::vector<Q15Complex> twiddles;
+    std::vector<Q15Complex> split;
+    std::vector<Q15Complex> work;
+  };
+
+}
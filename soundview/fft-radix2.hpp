@@ -0,0 +1,121 @@
+/* SoundView - Eye candy for your music
+ * Copyright (C) 2016 Nicholas Parker
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>. */
+
+
+#pragma once
+
+#include <stddef.h>
+#include <math.h>
+#include <complex>
+#include <vector>
+
+namespace soundview {
+
+  /**
+   * A self-contained FFT of real samples, for power-of-two lengths. Used when FFTW isn't
+   * available or isn't wanted, and has no dependencies beyond the standard library.
+   *
+   * The n real samples are packed into n/2 complex values, which go through an iterative radix-2
+   * FFT and are then split back apart into the n/2+1 bins of the real transform. This does about
+   * half the work of transforming the samples as n complex values. Output is unnormalized, like
+   * FFTW's.
+   */
+  template <typename T>
+  class Radix2Fft {
+   public:
+    /**
+     * Prepares for transforms of 'len' real samples, which must be a power of two of at least 4.
+     */
+    explicit Radix2Fft(size_t len)
+      : half(len / 2),
+        bitrev(half),
+        twiddles(half / 2),
+        split(half + 1),
+        work(half) {
+      const double two_pi = 6.28318530717958647692;
+      size_t bits = 0;
+      while (((size_t)1 << bits) < half) {
+        ++bits;
+      }
+      for (size_t i = 0; i < half; ++i) {
+        size_t rev = 0;
+        for (size_t b = 0; b < bits; ++b) {
+          if (i & ((size_t)1 << b)) {
+            rev |= (size_t)1 << (bits - 1 - b);
+          }
+        }
+        bitrev[i] = rev;
+      }
+      for (size_t k = 0; k < twiddles.size(); ++k) {
+        twiddles[k] = std::complex<T>(cos(two_pi * k / half), -sin(two_pi * k / half));
+      }
+      for (size_t k = 0; k < split.size(); ++k) {
+        split[k] = std::complex<T>(cos(two_pi * k / len), -sin(two_pi * k / len));
+      }
+    }
+
+    /**
+     * Transforms 'len' real samples from 'in' into 'len'/2+1 complex bins in 'out'.
+     */
+    void transform(const T* in, std::complex<T>* out) {
+      // pack pairs of samples as complex values, in the bit-reversed order wanted by the butterflies
+      for (size_t m = 0; m < half; ++m) {
+        work[bitrev[m]] = std::complex<T>(in[2 * m], in[2 * m + 1]);
+      }
+      for (size_t span = 1; span < half; span *= 2) {
+        // combine pairs of transforms of length 'span' into transforms of length 2*span
+        const size_t stride = half / (2 * span);
+        for (size_t start = 0; start < half; start += 2 * span) {
+          std::complex<T>* a = work.data() + start;
+          std::complex<T>* b = a + span;
+          for (size_t j = 0; j < span; ++j) {
+            const std::complex<T> t = mul(b[j], twiddles[j * stride]);
+            b[j] = a[j] - t;
+            a[j] = a[j] + t;
+          }
+        }
+      }
+      // the transforms of the even and odd samples are the conjugate-symmetric and antisymmetric
+      // parts of the packed transform
+      for (size_t k = 0; k <= half; ++k) {
+        const std::complex<T> z = work[(k == half) ? 0 : k];
+        const std::complex<T> zc = std::conj(work[(k == 0) ? 0 : half - k]);
+        const std::complex<T> even = (z + zc) * (T)0.5;
+        const std::complex<T> diff = z - zc;
+        const std::complex<T> odd(diff.imag() * (T)0.5, diff.real() * (T)-0.5);
+        out[k] = even + mul(split[k], odd);
+      }
+    }
+
+   private:
+    // std::complex's operator* handles infinities and NaNs, which makes it far slower than this
+    static std::complex<T> mul(const std::complex<T>& a, const std::complex<T>& b) {
+      return std::complex<T>(a.real() * b.real() - a.imag() * b.imag(),
+          a.real() * b.imag() + a.imag() * b.real());
+    }
+
+    // number of complex values in the packed transform
+    const size_t half;
+    // position of each packed value in bit-reversed order
+    std::vector<size_t> bitrev;
+    // exp(-2*pi*i*k/half), for the butterflies
+    std::vector<std::complex<T>> twiddles;
+    // exp(-2*pi*i*k/len), for splitting the packed transform
+    std::vector<std::complex<T>> split;
+    std::vector<std::complex<T>> work;
+  };
+
+}
@@ -0,0 +1,39 @@
+/* SoundView - Eye candy for your music
+ * Copyright (C) 2016 Nicholas Parker
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>. */
+
+#include "soundview/frame-pool.hpp"
+
+namespace {
+  // enough for several display refreshes' worth of frames at a small hop. if the display falls
+  // further behind than this, new frames are dropped until it catches up
+  const size_t POOL_FRAME_COUNT = 64;
+}
+
+soundview::FramePool::FramePool(const Options& options)
+  : frame_capacity(options.bucket_count()),
+    slab(POOL_FRAME_COUNT * aligned_len<freq_t>(frame_capacity), 0),
+    frames(POOL_FRAME_COUNT),
+    free_frames(POOL_FRAME_COUNT),
+    exhausted_count(0) {
+  for (size_t i = 0; i < frames.size(); ++i) {
+    Frame& frame = frames[i];
+    frame.seq = 0;
+    frame.len = 0;
+    frame.reduced = 0;
+    frame.data = slab.data() + (i * aligned_len<freq_t>(frame_capacity));
+    free_frames.push(&frame);
+  }
+}
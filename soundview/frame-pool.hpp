@@ -0,0 +1,95 @@
+/* SoundView - Eye candy for your music
+ * Copyright (C) 2016 Nicholas Parker
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>. */
+
+#pragma once
+
+#include <atomic>
+#include <vector>
+
+#include "soundview/aligned-allocator.hpp"
+#include "soundview/config.hpp"
+#include "soundview/frame.hpp"
+#include "soundview/options.hpp"
+#include "soundview/spsc-queue.hpp"
+
+namespace soundview {
+
+  /**
+   * A fixed set of preallocated frames, all backed by a single slab. The transformer acquires
+   * frames, fills them in place, and hands them to the display, which releases them back to the
+   * pool once they've been drawn. Nothing is allocated after construction. Each frame's data is
+   * aligned to BUFFER_ALIGNMENT for the SIMD kernels.
+   *
+   * Frames are acquired by one thread (the transformer) and released by one other thread (the
+   * display), so the list of free frames is a lock-free SpscQueue.
+   */
+  class LIB_API FramePool {
+   public:
+    FramePool(const Options& options);
+
+    /**
+     * Returns an unused frame with room for capacity() values, or NULL if all frames are in use.
+     */
+    Frame* acquire() {
+      Frame* frame;
+      if (free_frames.pop(frame)) {
+        return frame;
+      }
+      exhausted_count.store(exhausted_count.load(std::memory_order_relaxed) + 1,
+          std::memory_order_relaxed);
+      return NULL;
+    }
+
+    /**
+     * Returns a frame to the pool once it's no longer needed.
+     */
+    void release(Frame* frame) {
+      // can't fail: the queue has room for every frame
+      free_frames.push(frame);
+    }
+
+    /**
+     * Returns the number of times that acquire() failed because all frames were in use.
+     */
+    size_t exhausted() const {
+      return exhausted_count.load(std::memory_order_relaxed);
+    }
+
+    /**
+     * Returns the total number of frames in the pool.
+     */
+    size_t size() const {
+      return frames.size();
+    }
+
+    /**
+     * Returns the maximum number of values which may be stored in each frame.
+     */
+    size_t capacity() const {
+      return frame_capacity;
+    }
+
+   private:
+    const size_t frame_capacity;
+    aligned_vector<freq_t> slab;
+    std::vector<Frame> frames;
+
+    // frames which aren't currently in use. has room for all frames, so pushes never fail
+    SpscQueue<Frame*> free_frames;
+    std::atomic<size_t> exhausted_count;
+  };
+
+}
@@ -0,0 +1,80 @@
+/* SoundView - Eye candy for your music
+ * Copyright (C) 2016 Nicholas Parker
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>. */
+
+
+#include "soundview/config.hpp"
+#include "soundview/frame-reducer.hpp"
+
+namespace {
+  // the transformer retires at most one map for each map that's published, and the display
+  // deletes any retired maps each time it publishes, so this never fills up
+  const size_t RETIRED_MAP_COUNT = 4;
+}
+
+soundview::FrameReducer::FrameReducer(const Options& options)
+  : bucket_count(options.bucket_count()),
+    next_generation(1),
+    latest(NULL),
+    retired(RETIRED_MAP_COUNT),
+    current(NULL) { }
+
+soundview::FrameReducer::~FrameReducer() {
+  delete latest.exchange(NULL);
+  delete current;
+  Map* map;
+  while (retired.pop(map)) {
+    delete map;
+  }
+}
+
+uint32_t soundview::FrameReducer::publish(
+    const std::vector<size_t>& start, const std::vector<size_t>& end) {
+  // clean up maps which the transformer has since replaced
+  Map* map;
+  while (retired.pop(map)) {
+    delete map;
+  }
+
+  map = new Map;
+  if (start.empty() || start.size() >= bucket_count) {
+    // there aren't any fewer pixels than buckets, so there's nothing to gain from reducing
+    map->generation = 0;
+  } else {
+    map->generation = next_generation++;
+    if (next_generation == 0) {
+      next_generation = 1;
+    }
+    map->start.assign(start.begin(), start.end());
+    map->end.assign(end.begin(), end.end());
+  }
+  const uint32_t generation = map->generation;
+  DEBUG("Publishing pixel map %u with %lu pixels", generation, map->start.size());
+  // if the transformer never picked up the previous map, it's safe to delete it here
+  delete latest.exchange(map);
+  return generation;
+}
+
+void soundview::FrameReducer::update() {
+  Map* map = latest.exchange(NULL);
+  if (map == NULL) {
+    return;
+  }
+  if (current != NULL && !retired.push(current)) {
+    // shouldn't happen, see RETIRED_MAP_COUNT. fall back to freeing it on this thread
+    delete current;
+  }
+  current = map;
+}
@@ -0,0 +1,109 @@
+/* SoundView - Eye candy for your music
+ * Copyright (C) 2016 Nicholas Parker
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>. */
+
+
+#pragma once
+
+#include <stdint.h>
+#include <atomic>
+#include <vector>
+
+#include "soundview/config.hpp"
+#include "soundview/frame.hpp"
+#include "soundview/options.hpp"
+#include "soundview/spsc-queue.hpp"
+
+namespace soundview {
+
+  /**
+   * Lets the display hand its current mapping of buckets to pixels back to the transformer, so
+   * that the transformer can reduce each frame to one value per pixel before passing it along.
+   * Thousands of buckets typically end up on a few hundred pixels, so this keeps the amount of
+   * data passed to and processed by the display proportional to the window size rather than to
+   * the number of buckets.
+   *
+   * Each published map has a generation number, which is stored in the frames reduced with it.
+   * The display can then tell whether a frame's values are buckets (generation 0), pixels in its
+   * current layout, or pixels in a layout it's since replaced.
+   */
+  class LIB_API FrameReducer {
+   public:
+    FrameReducer(const Options& options);
+    ~FrameReducer();
+
+    // Display thread:
+
+    /**
+     * Publishes a new map where pixel i shows the max of buckets [start[i], end[i]), returning the
+     * generation which frames reduced with it will have. An empty map disables reduction, and
+     * returns 0.
+     */
+    uint32_t publish(const std::vector<size_t>& start, const std::vector<size_t>& end);
+
+    // Transformer thread:
+
+    /**
+     * Switches to the most recently published map, if any. Called before reducing a batch of
+     * frames.
+     */
+    void update();
+
+    /**
+     * Returns whether reduce() should be called for frames, ie whether a map is in use.
+     */
+    bool active() const {
+      return current != NULL && !current->start.empty();
+    }
+
+    /**
+     * Writes the max of each pixel's buckets from 'buckets' into 'frame'. Only valid if active().
+     */
+    void reduce(const freq_t* buckets, Frame* frame) const {
+      const uint32_t* start = current->start.data();
+      const uint32_t* end = current->end.data();
+      const size_t len = current->start.size();
+      for (size_t px = 0; px < len; ++px) {
+        freq_t val = buckets[start[px]];
+        for (uint32_t i = start[px] + 1; i < end[px]; ++i) {
+          if (buckets[i] > val) {
+            val = buckets[i];
+          }
+        }
+        frame->data[px] = val;
+      }
+      frame->len = len;
+      frame->reduced = current->generation;
+    }
+
+   private:
+    struct Map {
+      uint32_t generation;
+      std::vector<uint32_t> start;
+      std::vector<uint32_t> end;
+    };
+
+    const size_t bucket_count;
+    // display-owned
+    uint32_t next_generation;
+    // the newest published map, if the transformer hasn't picked it up yet
+    std::atomic<Map*> latest;
+    // maps which the transformer is done with, to be deleted by the display
+    SpscQueue<Map*> retired;
+    // transformer-owned
+    Map* current;
+  };
+
+}
@@ -0,0 +1,226 @@
+/* SoundView - Eye candy for your music
+ * Copyright (C) 2016 Nicholas Parker
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>. */
+
+
+#include <algorithm>
+
+#include "soundview/config.hpp"
+#include "soundview/frame-scheduler.hpp"
+
+namespace {
+  // the most columns which may be produced by one call to advance(). if the display falls further
+  // behind than this (eg while the window is being dragged), the extra time is skipped
+  const size_t MAX_COLUMNS_PER_PASS = 16;
+
+  // scrolling stops once the newest frame is this old, ie when the audio device has stopped
+  const std::chrono::milliseconds STALL_TIMEOUT(250);
+
+  // how many of the most recent frame times to keep for computing percentiles
+  const size_t FRAME_TIME_SAMPLES = 1024;
+
+  uint32_t percentile(std::vector<uint32_t>& vals, size_t pct) {
+    std::vector<uint32_t>::iterator nth = vals.begin() + ((vals.size() - 1) * pct / 100);
+    std::nth_element(vals.begin(), nth, vals.end());
+    return *nth;
+  }
+}
+
+soundview::FrameScheduler::FrameScheduler(const Options& options, FramePool& pool)
+  : pool(pool),
+    period(std::chrono::duration_cast<frame_clock_t::duration>(
+            std::chrono::duration<double>(1. / options.display_fps_max()))),
+    // frames are delivered in bursts each time the device is polled, so stay far enough behind
+    // the newest frame for the next burst to arrive in time
+    latency(std::chrono::duration_cast<frame_clock_t::duration>(
+            std::chrono::duration<double>(1. / options.audio_collect_rate_hz())) + period),
+    last(NULL),
+    scratch_slab(MAX_COLUMNS_PER_PASS * aligned_len<freq_t>(pool.capacity()), 0),
+    scratch(MAX_COLUMNS_PER_PASS),
+    started(false),
+    frame_times_us(FRAME_TIME_SAMPLES, 0),
+    frame_times_count(0),
+    columns_direct(0),
+    columns_merged(0),
+    columns_interpolated(0),
+    columns_duplicated(0),
+    columns_skipped(0) {
+  pending.reserve(pool.size());
+  consumed.reserve(pool.size());
+  for (size_t i = 0; i < scratch.size(); ++i) {
+    Frame& frame = scratch[i];
+    frame.seq = 0;
+    frame.len = 0;
+    frame.reduced = 0;
+    frame.data = scratch_slab.data() + (i * aligned_len<freq_t>(pool.capacity()));
+  }
+}
+
+soundview::FrameScheduler::~FrameScheduler() {
+  for (Frame* frame : pending) {
+    pool.release(frame);
+  }
+  for (Frame* frame : consumed) {
+    pool.release(frame);
+  }
+  if (last != NULL) {
+    pool.release(last);
+  }
+}
+
+void soundview::FrameScheduler::add(Frame* frame) {
+  pending.push_back(frame);
+}
+
+void soundview::FrameScheduler::advance(
+    frame_clock_t::time_point now, std::vector<const Frame*>& columns) {
+  columns.clear();
+  for (Frame* frame : consumed) {
+    pool.release(frame);
+  }
+  consumed.clear();
+
+  if (!started) {
+    if (pending.empty()) {
+      return;
+    }
+    // (re)start with the oldest frame as the first column
+    next_column_time = pending.front()->timestamp;
+    started = true;
+  }
+
+  const frame_clock_t::time_point target = now - latency;
+  if (target - next_column_time >= period * MAX_COLUMNS_PER_PASS) {
+    const frame_clock_t::time_point skip_to = target - (period * (MAX_COLUMNS_PER_PASS - 1));
+    columns_skipped += (skip_to - next_column_time) / period;
+    next_column_time = skip_to;
+  }
+
+  size_t scratch_used = 0;
+  while (next_column_time <= target) {
+    // the frames which are due in this column: anything captured up to the end of its timestep
+    size_t due = 0;
+    while (due < pending.size() && pending[due]->timestamp <= next_column_time) {
+      ++due;
+    }
+    // frames can only be combined if they have the same layout. if the display was resized
+    // partway through, use just the newest one
+    size_t mergeable = 1;
+    while (mergeable < due && pending[due - 1 - mergeable]->reduced == pending[due - 1]->reduced) {
+      ++mergeable;
+    }
+
+    const Frame* column;
+    if (due > 0 && mergeable == 1) {
+      column = pending[due - 1];
+      ++columns_direct;
+    } else if (due > 1) {
+      // merge: keep the loudest value for each bucket
+      Frame* merged = scratch_frame(scratch_used);
+      const Frame* newest = pending[due - 1];
+      merged->seq = newest->seq;
+      merged->timestamp = newest->timestamp;
+      merged->len = newest->len;
+      merged->reduced = newest->reduced;
+      std::copy(newest->data, newest->data + newest->len, merged->data);
+      for (size_t f = due - mergeable; f < due - 1; ++f) {
+        const Frame* frame = pending[f];
+        const size_t len = std::min(frame->len, merged->len);
+        for (size_t i = 0; i < len; ++i) {
+          merged->data[i] = std::max(merged->data[i], frame->data[i]);
+        }
+      }
+      column = merged;
+      ++columns_merged;
+    } else if (last == NULL) {
+      break;
+    } else if (!pending.empty() && pending.front()->reduced == last->reduced
+        && pending.front()->timestamp - last->timestamp < STALL_TIMEOUT) {
+      // interpolate between the last frame and the next one, by how far this column is between
+      const Frame* next = pending.front();
+      const double frac = std::chrono::duration<double>(next_column_time - last->timestamp)
+        / std::chrono::duration<double>(next->timestamp - last->timestamp);
+      Frame* interp = scratch_frame(scratch_used);
+      interp->seq = last->seq;
+      interp->timestamp = next_column_time;
+      interp->len = std::min(last->len, next->len);
+      interp->reduced = last->reduced;
+      for (size_t i = 0; i < interp->len; ++i) {
+        interp->data[i] = last->data[i] + (next->data[i] - last->data[i]) * frac;
+      }
+      column = interp;
+      ++columns_interpolated;
+    } else if (next_column_time - last->timestamp < STALL_TIMEOUT) {
+      // the next frame hasn't arrived yet: repeat the last one
+      column = last;
+      ++columns_duplicated;
+    } else {
+      // the device has gone quiet: stop scrolling until frames arrive again
+      started = false;
+      last_column_time = frame_clock_t::time_point();
+      break;
+    }
+
+    if (due > 0) {
+      // the newest due frame becomes 'last', and everything else is released on the next pass
+      if (last != NULL) {
+        consumed.push_back(last);
+      }
+      consumed.insert(consumed.end(), pending.begin(), pending.begin() + (due - 1));
+      last = pending[due - 1];
+      pending.erase(pending.begin(), pending.begin() + due);
+    }
+    columns.push_back(column);
+    next_column_time += period;
+  }
+
+  if (!columns.empty()) {
+    record_frame_time(now);
+  }
+}
+
+soundview::frame_clock_t::time_point soundview::FrameScheduler::next_due() const {
+  if (!started) {
+    return frame_clock_t::time_point::max();
+  }
+  return next_column_time + latency;
+}
+
+void soundview::FrameScheduler::log_stats() const {
+  const size_t samples = std::min(frame_times_count, frame_times_us.size());
+  if (samples == 0) {
+    return;
+  }
+  std::vector<uint32_t> sorted(frame_times_us.begin(), frame_times_us.begin() + samples);
+  LOG("Frame times over last %lu frames (target %ldus): p50 %uus, p90 %uus, p99 %uus",
+      samples, (long) std::chrono::duration_cast<std::chrono::microseconds>(period).count(),
+      percentile(sorted, 50), percentile(sorted, 90), percentile(sorted, 99));
+  LOG("Columns: %lu direct, %lu merged, %lu interpolated, %lu duplicated, %lu skipped",
+      columns_direct, columns_merged, columns_interpolated, columns_duplicated, columns_skipped);
+}
+
+soundview::Frame* soundview::FrameScheduler::scratch_frame(size_t& scratch_used) {
+  // can't run out: advance() never produces more than MAX_COLUMNS_PER_PASS columns
+  return &scratch[scratch_used++];
+}
+
+void soundview::FrameScheduler::record_frame_time(frame_clock_t::time_point now) {
+  if (last_column_time != frame_clock_t::time_point()) {
+    frame_times_us[frame_times_count % frame_times_us.size()] = (uint32_t)
+      std::chrono::duration_cast<std::chrono::microseconds>(now - last_column_time).count();
+    ++frame_times_count;
+  }
+  last_column_time = now;
+}
@@ -0,0 +1,97 @@
+/* SoundView - Eye candy for your music
+ * Copyright (C) 2016 Nicholas Parker
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>. */
+
+
+#pragma once
+
+#include <stdint.h>
+#include <vector>
+
+#include "soundview/frame-pool.hpp"
+#include "soundview/options.hpp"
+
+namespace soundview {
+
+  /**
+   * Decides which frames are drawn as which voiceprint columns, so that the voiceprint scrolls at a
+   * constant rate regardless of how unevenly frames arrive from the audio device.
+   *
+   * Columns are produced on a fixed timestep of 1/display_fps_max() seconds, trailing the frames'
+   * timestamps by a short latency to absorb the device's collection interval. Each column shows
+   * the frames which were captured within its timestep: several frames are merged into one by
+   * taking the max of each bucket, while a timestep with no frames is filled by interpolating
+   * between its neighbors, or by duplicating the previous column if the next frame hasn't arrived.
+   * Scrolling stops if no frames arrive for a while, and resumes once they do.
+   *
+   * Single-threaded: only used by the display thread.
+   */
+  class FrameScheduler {
+   public:
+    FrameScheduler(const Options& options, FramePool& pool);
+    ~FrameScheduler();
+
+    /**
+     * Queues a frame from the transformer. It's released to the pool once it's been drawn.
+     */
+    void add(Frame* frame);
+
+    /**
+     * Fills 'columns' with a frame for each column which has become due as of 'now', oldest
+     * first. The returned frames remain valid until the next call to advance().
+     */
+    void advance(frame_clock_t::time_point now, std::vector<const Frame*>& columns);
+
+    /**
+     * Returns when the next column will be due, or time_point::max() if waiting for frames.
+     */
+    frame_clock_t::time_point next_due() const;
+
+    /**
+     * Logs how evenly columns have been produced, and how they were filled.
+     */
+    void log_stats() const;
+
+   private:
+    Frame* scratch_frame(size_t& scratch_used);
+    void record_frame_time(frame_clock_t::time_point now);
+
+    FramePool& pool;
+    const frame_clock_t::duration period;
+    const frame_clock_t::duration latency;
+
+    // frames which have been added but not yet drawn, oldest first
+    std::vector<Frame*> pending;
+    // the most recently drawn frame, kept for duplicating or interpolating into later columns
+    Frame* last;
+    // frames which have been drawn, to be released on the next call to advance()
+    std::vector<Frame*> consumed;
+
+    // storage for merged and interpolated columns
+    aligned_vector<freq_t> scratch_slab;
+    std::vector<Frame> scratch;
+
+    bool started;
+    frame_clock_t::time_point next_column_time;
+
+    // stats
+    frame_clock_t::time_point last_column_time;
+    std::vector<uint32_t> frame_times_us;
+    size_t frame_times_count;
+    size_t columns_direct, columns_merged, columns_interpolated, columns_duplicated;
+    size_t columns_skipped;
+  };
+
+}
@@ -0,0 +1,50 @@
+/* SoundView - Eye candy for your music
+ * Copyright (C) 2016 Nicholas Parker
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>. */
+
+#pragma once
+
+#include <stdint.h>
+#include <chrono>
+
+namespace soundview {
+
+  /**
+   * The type used for frequency magnitudes passed from the transformer to the display. These
+   * values end up as 8-bit colors, so single precision is plenty regardless of FFT precision.
+   */
+  typedef float freq_t;
+
+  typedef std::chrono::steady_clock frame_clock_t;
+
+  /**
+   * A single frame of frequency magnitudes. Frames are fixed-capacity and are allocated up front
+   * by a FramePool, so that passing them from the transformer to the display doesn't allocate.
+   */
+  struct Frame {
+    // sequence number of this frame, incremented for each frame produced by the transformer
+    uint64_t seq;
+    // when the most recent sample in this frame was received from the device
+    frame_clock_t::time_point timestamp;
+    // number of values in data
+    size_t len;
+    // 0 if data has a value for each bucket, otherwise the generation of the FrameReducer map
+    // which reduced data to a value for each pixel
+    uint32_t reduced;
+    // storage for the frame's values, owned by the FramePool
+    freq_t* data;
+  };
+
+}
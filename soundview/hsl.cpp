@@ -17,10 +17,24 @@
 #include <math.h>
 #include <algorithm>
 
+#include "soundview/config.hpp"
 #include "soundview/hsl.hpp"
 
 namespace {
 
+  // Evenly spaced samples of palettes from matplotlib, interpolated to fill the lookup table.
+  const size_t PALETTE_STOPS = 9;
+  const uint8_t VIRIDIS[PALETTE_STOPS][3] = {
+    {0x44, 0x01, 0x54}, {0x47, 0x2d, 0x7b}, {0x3b, 0x52, 0x8b}, {0x2c, 0x72, 0x8e},
+    {0x21, 0x91, 0x8c}, {0x28, 0xae, 0x80}, {0x5e, 0xc9, 0x62}, {0xad, 0xdc, 0x30},
+    {0xfd, 0xe7, 0x25}};
+  const uint8_t MAGMA[PALETTE_STOPS][3] = {
+    {0x00, 0x00, 0x04}, {0x1c, 0x10, 0x44}, {0x4f, 0x12, 0x7b}, {0x81, 0x25, 0x81},
+    {0xb5, 0x36, 0x7a}, {0xe5, 0x50, 0x64}, {0xfb, 0x87, 0x61}, {0xfe, 0xc2, 0x87},
+    {0xfc, 0xfd, 0xbf}};
+  const uint8_t GRAYSCALE[2][3] = {
+    {0x00, 0x00, 0x00}, {0xff, 0xff, 0xff}};
+
   const double ONE_SIXTH = 1 / 6.f;
   const double ONE_THIRD = 1 / 3.f;
   const double ONE_HALF = 1 / 2.f;
@@ -74,23 +88,67 @@ namespace {
           hueToRgbValWithQ1(lum, H - ONE_THIRD) * 255);
     }
   }
+
+  template <size_t N>
+  sf::Color paletteToColor(const uint8_t (&stops)[N][3], double lum_exponent, double value) {
+    // exaggerate quiet values the same way as the HSL palette does via luminosity
+    const double pos = std::min(1., pow(value, lum_exponent)) * (N - 1);
+    const size_t lo = std::min((size_t) pos, N - 2);
+    const double frac = pos - lo;
+    return sf::Color(
+        stops[lo][0] + (stops[lo + 1][0] - stops[lo][0]) * frac,
+        stops[lo][1] + (stops[lo + 1][1] - stops[lo][1]) * frac,
+        stops[lo][2] + (stops[lo + 1][2] - stops[lo][2]) * frac);
+  }
+
+  sf::Color paletteToColor(const std::string& palette,
+      double max_lum, double lum_exponent, double value) {
+    if (palette == "viridis") {
+      return paletteToColor(VIRIDIS, lum_exponent, value);
+    } else if (palette == "magma") {
+      return paletteToColor(MAGMA, lum_exponent, value);
+    } else if (palette == "grayscale") {
+      return paletteToColor(GRAYSCALE, lum_exponent, value);
+    }
+    return valueToColor(max_lum, lum_exponent, value);
+  }
 }
 
 soundview::HSL::HSL(const Options& options) {
-  size_t cache_size = 1024;
+  const std::string palette = options.color_palette();
+  const size_t cache_size = options.color_lut_size();
   double max_lum = options.color_max_lum() / 100.;
   double lum_exponent = 1 - (options.color_lum_exaggeration() / 100.);
   for (size_t i = 0; i < cache_size; ++i) {
-    precached_vals.push_back(::valueToColor(max_lum, lum_exponent, i / (double) cache_size));
+    precached_vals.push_back(pack(
+            paletteToColor(palette, max_lum, lum_exponent, i / (double) cache_size)));
   }
   precached_vals_size = precached_vals.size();
+  precached_vals_max = precached_vals_size - 1;
+  // levels are drawn at their exact value, rather than at the table entry below it
+  for (size_t i = 0; i < 256; ++i) {
+    precached_levels.push_back(pack(paletteToColor(palette, max_lum, lum_exponent, i / 255.)));
+  }
+  DEBUG("Palette %s with %lu colors", palette.c_str(), cache_size);
+}
+
+void soundview::HSL::valuesToRgba(
+    const freq_t* values, size_t len, float scale, rgba_t* out) const {
+  // computing all the indexes first keeps this loop simple enough for the compiler to vectorize
+  const float index_scale = scale * precached_vals_size;
+  const float index_max = precached_vals_max;
+  for (size_t i = 0; i < len; ++i) {
+    out[i] = (rgba_t) std::min(values[i] * index_scale, index_max);
+  }
+  const rgba_t* lut = precached_vals.data();
+  for (size_t i = 0; i < len; ++i) {
+    out[i] = lut[out[i]];
+  }
 }
 
-sf::Color soundview::HSL::valueToColor(double value) const {
-  size_t max_index = precached_vals_size - 1;
-  size_t index = value * precached_vals_size;
-  if (index > max_index) {
-    index = max_index;
+void soundview::HSL::levelsToRgba(const uint8_t* levels, size_t len, rgba_t* out) const {
+  const rgba_t* lut = precached_levels.data();
+  for (size_t i = 0; i < len; ++i) {
+    out[i] = lut[levels[i]];
   }
-  return precached_vals[index];
 }
@@ -16,15 +16,24 @@
 
 #pragma once
 
+#include <stdint.h>
 #include <vector>
 #include <SFML/Graphics/Color.hpp>
 
+#include "soundview/frame.hpp"
 #include "soundview/options.hpp"
 
 namespace soundview {
 
   /**
-   * Transforms amplitude values to colors.
+   * A packed color, with the same layout in memory as the RGBA pixels passed to sf::Texture.
+   */
+  typedef uint32_t rgba_t;
+
+  /**
+   * Transforms amplitude values to colors, using the palette selected by color_palette(). Colors
+   * are precomputed into a lookup table of color_lut_size() entries, with a second table of 256
+   * entries for 8-bit levels.
    */
   class HSL {
    public:
@@ -34,11 +43,52 @@ namespace soundview {
      * Given a calculated value and a desired luminosity for that value, returns an Android color
      * code. This is a reduced version of the normal HSL->RGB algorithm; it always has S=1.
      */
-    sf::Color valueToColor(double value) const;
+    sf::Color valueToColor(double value) const {
+      return unpack(valueToRgba(value));
+    }
+
+    /**
+     * Returns the packed color for a value between 0 and 1.
+     */
+    rgba_t valueToRgba(double value) const {
+      size_t index = value * precached_vals_size;
+      if (index > precached_vals_max) {
+        index = precached_vals_max;
+      }
+      return precached_vals[index];
+    }
+
+    /**
+     * Converts 'len' values to packed colors, after multiplying each value by 'scale'. Pass the
+     * reciprocal of the maximum value as 'scale' to normalize the values to 0-1.
+     */
+    void valuesToRgba(const freq_t* values, size_t len, float scale, rgba_t* out) const;
+
+    /**
+     * Converts 'len' 8-bit levels to packed colors, where 255 is the loudest.
+     */
+    void levelsToRgba(const uint8_t* levels, size_t len, rgba_t* out) const;
+
+    static rgba_t pack(const sf::Color& color) {
+      rgba_t rgba;
+      uint8_t* bytes = reinterpret_cast<uint8_t*>(&rgba);
+      bytes[0] = color.r;
+      bytes[1] = color.g;
+      bytes[2] = color.b;
+      bytes[3] = color.a;
+      return rgba;
+    }
+
+    static sf::Color unpack(rgba_t rgba) {
+      const uint8_t* bytes = reinterpret_cast<const uint8_t*>(&rgba);
+      return sf::Color(bytes[0], bytes[1], bytes[2], bytes[3]);
+    }
 
    private:
-    std::vector<sf::Color> precached_vals;
+    std::vector<rgba_t> precached_vals;
     size_t precached_vals_size;
+    size_t precached_vals_max;
+    std::vector<rgba_t> precached_levels;
   };
 
 }
@@ -28,21 +28,39 @@ namespace soundview {
     virtual bool list_devices() const = 0;
     virtual std::string device() const = 0;
 
+    virtual std::string state_dir() const = 0;
+
     virtual size_t audio_collect_rate_hz() const = 0;
     virtual size_t audio_sample_rate_hz() const = 0;
 
     virtual size_t display_fps_max() const = 0;
     virtual bool display_vsync() const = 0;
     virtual bool display_fullscreen() const = 0;
+    virtual size_t display_render_scale() const = 0;
+    virtual std::string display_render_filter() const = 0;
 
     virtual size_t bucket_count() const = 0;
     virtual size_t bucket_bass_exaggeration() const = 0;
 
+    virtual std::string fft_engine() const = 0;
+    virtual size_t fft_size() const = 0;
+    virtual size_t fft_hop() const = 0;
+    virtual std::string fft_window() const = 0;
+    virtual std::string fft_precision() const = 0;
+    virtual std::string fft_planner() const = 0;
+    virtual size_t fft_threads() const = 0;
+
     virtual size_t color_lum_exaggeration() const = 0;
     virtual size_t color_max_lum() const = 0;
+    virtual std::string color_palette() const = 0;
+    virtual size_t color_lut_size() const = 0;
 
     virtual size_t analyzer_width_pct() const = 0;
     virtual size_t voiceprint_scroll_rate() const = 0;
+    virtual std::string voiceprint_renderer() const = 0;
+    virtual size_t voiceprint_history_secs() const = 0;
+    virtual size_t scrollback_minutes() const = 0;
+    virtual size_t scrollback_mb() const = 0;
     virtual size_t loudness_adjust_rate() const = 0;
   };
 
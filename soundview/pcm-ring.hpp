@@ -0,0 +1,204 @@
+/* SoundView - Eye candy for your music
+ * Copyright (C) 2016 Nicholas Parker
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>. */
+
+
+#pragma once
+
+#include <stdint.h>
+#include <algorithm>
+#include <atomic>
+#include <vector>
+
+#include "soundview/aligned-allocator.hpp"
+#include "soundview/frame.hpp"
+#include "soundview/spsc-queue.hpp"
+
+namespace soundview {
+
+  /**
+   * A block of samples which was written to a PcmRing in one piece. The samples may wrap around
+   * the end of the ring, in which case they're split across data[0] and data[1].
+   */
+  struct PcmBlock {
+    const int16_t* data[2];
+    size_t len[2];
+    // when the last sample in the block was received from the device
+    frame_clock_t::time_point timestamp;
+    // position of the end of the block, for PcmRing::release()
+    size_t end;
+  };
+
+  /**
+   * Lock-free ring of PCM samples, for passing blocks of samples from the device's capture thread
+   * to an analysis thread. The capture thread never waits for the analysis thread: when the ring
+   * doesn't have room for a whole block, the block is dropped and counted as an overrun.
+   */
+  class PcmRing {
+   public:
+    /**
+     * Creates a ring with room for at least 'min_samples' samples, in up to 'max_blocks' blocks.
+     */
+    PcmRing(size_t min_samples, size_t max_blocks)
+      : samples(round_up_pow2(min_samples)),
+        mask(samples.size() - 1),
+        blocks(max_blocks),
+        head(0),
+        tail(0),
+        overruns_(0),
+        overrun_samples_(0),
+        max_fill_(0) { }
+
+    /**
+     * Copies a block of samples into the ring, or drops it and returns false if the ring is full.
+     * Producer thread only.
+     */
+    bool write(const int16_t* in, size_t len, frame_clock_t::time_point timestamp) {
+      const size_t fill = tail - head.load(std::memory_order_acquire);
+      if (len > samples.size() - fill) {
+        overrun(len);
+        return false;
+      }
+      const size_t pos = tail & mask;
+      const size_t first_len = std::min(len, samples.size() - pos);
+      std::copy(in, in + first_len, samples.begin() + pos);
+      std::copy(in + first_len, in + len, samples.begin());
+      // the samples only become visible to the consumer once the block is pushed
+      Block block;
+      block.start = tail;
+      block.len = len;
+      block.timestamp = timestamp;
+      if (!blocks.push(block)) {
+        overrun(len);
+        return false;
+      }
+      tail += len;
+      if (fill + len > max_fill_.load(std::memory_order_relaxed)) {
+        max_fill_.store(fill + len, std::memory_order_relaxed);
+      }
+      return true;
+    }
+
+    /**
+     * Retrieves the oldest block in the ring, or returns false if the ring is empty. The block's
+     * samples remain valid until it's passed to release(). Consumer thread only.
+     */
+    bool read(PcmBlock& out) {
+      Block block;
+      if (!blocks.pop(block)) {
+        return false;
+      }
+      const size_t pos = block.start & mask;
+      out.len[0] = std::min(block.len, samples.size() - pos);
+      out.len[1] = block.len - out.len[0];
+      out.data[0] = samples.data() + pos;
+      out.data[1] = samples.data();
+      out.timestamp = block.timestamp;
+      out.end = block.start + block.len;
+      return true;
+    }
+
+    /**
+     * Returns the space used by a block from read() to the producer. Consumer thread only.
+     */
+    void release(const PcmBlock& block) {
+      head.store(block.end, std::memory_order_release);
+    }
+
+    /**
+     * Returns whether there are no blocks to read. Consumer thread only.
+     */
+    bool empty() {
+      return blocks.empty();
+    }
+
+    /**
+     * Returns the maximum number of samples which may be in the ring at once.
+     */
+    size_t capacity() const {
+      return samples.size();
+    }
+
+    // Counters, which may be read from any thread:
+
+    /**
+     * Returns the total number of blocks which have been written.
+     */
+    size_t written() const {
+      return blocks.enqueued();
+    }
+
+    /**
+     * Returns the total number of blocks which were dropped because the ring was full.
+     */
+    size_t overruns() const {
+      return overruns_.load(std::memory_order_relaxed);
+    }
+
+    /**
+     * Returns the total number of samples in the blocks counted by overruns().
+     */
+    size_t overrun_samples() const {
+      return overrun_samples_.load(std::memory_order_relaxed);
+    }
+
+    /**
+     * Returns the most samples which have been in the ring at once.
+     */
+    size_t max_fill() const {
+      return max_fill_.load(std::memory_order_relaxed);
+    }
+
+   private:
+    static const size_t CACHE_LINE = 64;
+
+    struct Block {
+      size_t start;
+      size_t len;
+      frame_clock_t::time_point timestamp;
+    };
+
+    static size_t round_up_pow2(size_t val) {
+      size_t ret = 1;
+      while (ret < val) {
+        ret <<= 1;
+      }
+      return ret;
+    }
+
+    void overrun(size_t len) {
+      overruns_.store(overruns_.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+      overrun_samples_.store(
+          overrun_samples_.load(std::memory_order_relaxed) + len, std::memory_order_relaxed);
+    }
+
+    aligned_vector<int16_t> samples;
+    const size_t mask;
+    // the position and timestamp of each block, which also publishes its samples to the consumer
+    SpscQueue<Block> blocks;
+
+    // consumer side: the end of the last released block. padded away from the producer's fields
+    char pad_before[CACHE_LINE];
+    std::atomic<size_t> head;
+    char pad_after[CACHE_LINE - sizeof(std::atomic<size_t>)];
+
+    // producer side: the end of the last written block, and counters
+    size_t tail;
+    std::atomic<size_t> overruns_;
+    std::atomic<size_t> overrun_samples_;
+    std::atomic<size_t> max_fill_;
+  };
+
+}
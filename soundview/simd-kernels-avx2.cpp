@@ -0,0 +1,166 @@
+/* SoundView - Eye candy for your music
+ * Copyright (C) 2016 Nicholas Parker
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>. */
+
+
+#include "soundview/simd-kernels-impl.hpp"
+
+#ifdef SOUNDVIEW_SIMD_X86
+
+#include <algorithm>
+#include <immintrin.h>
+
+/* Built with -mavx2. Anything left over after the last full vector is passed to the scalar
+ * kernels. */
+
+namespace {
+  void pcm_to_float(const int16_t* in, size_t len, float* out) {
+    size_t i = 0;
+    for (; i + 8 <= len; i += 8) {
+      const __m256i x = _mm256_cvtepi16_epi32(_mm_loadu_si128((const __m128i*)(in + i)));
+      _mm256_storeu_ps(out + i, _mm256_cvtepi32_ps(x));
+    }
+    soundview::scalar_kernels().pcm_to_float(in + i, len - i, out + i);
+  }
+
+  void pcm_to_double(const int16_t* in, size_t len, double* out) {
+    size_t i = 0;
+    for (; i + 8 <= len; i += 8) {
+      const __m256i x = _mm256_cvtepi16_epi32(_mm_loadu_si128((const __m128i*)(in + i)));
+      _mm256_storeu_pd(out + i, _mm256_cvtepi32_pd(_mm256_castsi256_si128(x)));
+      _mm256_storeu_pd(out + i + 4, _mm256_cvtepi32_pd(_mm256_extracti128_si256(x, 1)));
+    }
+    soundview::scalar_kernels().pcm_to_double(in + i, len - i, out + i);
+  }
+
+  void magnitudes_float(const std::complex<float>* in, size_t len, soundview::freq_t* out) {
+    const float* in_f = reinterpret_cast<const float*>(in);
+    size_t i = 0;
+    for (; i + 8 <= len; i += 8) {
+      const __m256 a = _mm256_loadu_ps(in_f + 2 * i), b = _mm256_loadu_ps(in_f + 2 * i + 8);
+      // shuffles stay within 128-bit lanes, so these are in the order 0 1 4 5 2 3 6 7
+      const __m256 re = _mm256_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0));
+      const __m256 im = _mm256_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1));
+      const __m256 mag = _mm256_sqrt_ps(_mm256_add_ps(_mm256_mul_ps(re, re), _mm256_mul_ps(im, im)));
+      _mm256_storeu_ps(out + i, _mm256_castpd_ps(
+              _mm256_permute4x64_pd(_mm256_castps_pd(mag), _MM_SHUFFLE(3, 1, 2, 0))));
+    }
+    soundview::scalar_kernels().magnitudes_float(in + i, len - i, out + i);
+  }
+
+  void magnitudes_double(const std::complex<double>* in, size_t len, soundview::freq_t* out) {
+    const double* in_d = reinterpret_cast<const double*>(in);
+    size_t i = 0;
+    for (; i + 4 <= len; i += 4) {
+      const __m256d a = _mm256_loadu_pd(in_d + 2 * i), b = _mm256_loadu_pd(in_d + 2 * i + 4);
+      // in the order 0 2 1 3
+      const __m256d re = _mm256_unpacklo_pd(a, b), im = _mm256_unpackhi_pd(a, b);
+      const __m128 mag = _mm256_cvtpd_ps(
+          _mm256_sqrt_pd(_mm256_add_pd(_mm256_mul_pd(re, re), _mm256_mul_pd(im, im))));
+      _mm_storeu_ps(out + i, _mm_shuffle_ps(mag, mag, _MM_SHUFFLE(3, 1, 2, 0)));
+    }
+    soundview::scalar_kernels().magnitudes_double(in + i, len - i, out + i);
+  }
+
+  void magnitudes_q15(const int16_t* in, size_t len, soundview::freq_t* out) {
+    size_t i = 0;
+    for (; i + 8 <= len; i += 8) {
+      const __m256i x = _mm256_loadu_si256((const __m256i*)(in + 2 * i));
+      // re^2 + im^2 for each value, which is only negative when it's exactly 2^31
+      const __m256 sum = _mm256_cvtepi32_ps(_mm256_madd_epi16(x, x));
+      const __m256 fix = _mm256_and_ps(_mm256_cmp_ps(sum, _mm256_setzero_ps(), _CMP_LT_OQ),
+          _mm256_set1_ps(4294967296.f));
+      _mm256_storeu_ps(out + i, _mm256_sqrt_ps(_mm256_add_ps(sum, fix)));
+    }
+    soundview::scalar_kernels().magnitudes_q15(in + 2 * i, len - i, out + i);
+  }
+
+  uint64_t abs_sum(const int16_t* in, size_t len) {
+    // each vector adds at most 32768 to a 32-bit lane, so flush the lanes into 'sum' often enough
+    // that they can't overflow
+    const size_t block_len = 8 * 65536;
+    uint64_t sum = 0;
+    size_t i = 0;
+    while (i + 8 <= len) {
+      const size_t block_end = i + std::min(block_len, (len - i) & ~(size_t)7);
+      __m256i acc = _mm256_setzero_si256();
+      for (; i < block_end; i += 8) {
+        const __m256i x = _mm256_cvtepi16_epi32(_mm_loadu_si128((const __m128i*)(in + i)));
+        acc = _mm256_add_epi32(acc, _mm256_abs_epi32(x));
+      }
+      const __m256i acc64 = _mm256_add_epi64(
+          _mm256_cvtepu32_epi64(_mm256_castsi256_si128(acc)),
+          _mm256_cvtepu32_epi64(_mm256_extracti128_si256(acc, 1)));
+      uint64_t lanes[4];
+      _mm256_storeu_si256((__m256i*)lanes, acc64);
+      sum += lanes[0] + lanes[1] + lanes[2] + lanes[3];
+    }
+    return sum + soundview::scalar_kernels().abs_sum(in + i, len - i);
+  }
+
+  soundview::freq_t max_value(const soundview::freq_t* in, size_t len, soundview::freq_t init) {
+    size_t i = 0;
+    if (len >= 8) {
+      __m256 max8 = _mm256_set1_ps(init);
+      for (; i + 8 <= len; i += 8) {
+        // NaN values are skipped like in the scalar loop: see sse2
+        max8 = _mm256_max_ps(_mm256_loadu_ps(in + i), max8);
+      }
+      __m128 max = _mm_max_ps(_mm256_castps256_ps128(max8), _mm256_extractf128_ps(max8, 1));
+      max = _mm_max_ps(max, _mm_shuffle_ps(max, max, _MM_SHUFFLE(1, 0, 3, 2)));
+      max = _mm_max_ps(max, _mm_shuffle_ps(max, max, _MM_SHUFFLE(2, 3, 0, 1)));
+      init = _mm_cvtss_f32(max);
+    }
+    return soundview::scalar_kernels().max_value(in + i, len - i, init);
+  }
+
+  // scales, rounds and clamps eight values to 0-255
+  inline __m256i quantize8(const float* in, __m256 scale) {
+    const __m256 val = _mm256_add_ps(_mm256_mul_ps(_mm256_loadu_ps(in), scale), _mm256_set1_ps(0.5f));
+    return _mm256_cvttps_epi32(
+        _mm256_min_ps(_mm256_max_ps(val, _mm256_setzero_ps()), _mm256_set1_ps(255)));
+  }
+
+  void quantize(const soundview::freq_t* in, size_t len, float scale, uint8_t* out) {
+    const __m256 scale_v = _mm256_set1_ps(scale);
+    size_t i = 0;
+    for (; i + 16 <= len; i += 16) {
+      // packing stays within 128-bit lanes, so put the 64-bit groups back in order afterwards
+      const __m256i packed = _mm256_permute4x64_epi64(
+          _mm256_packs_epi32(quantize8(in + i, scale_v), quantize8(in + i + 8, scale_v)),
+          _MM_SHUFFLE(3, 1, 2, 0));
+      _mm_storeu_si128((__m128i*)(out + i), _mm_packus_epi16(
+              _mm256_castsi256_si128(packed), _mm256_extracti128_si256(packed, 1)));
+    }
+    soundview::scalar_kernels().quantize(in + i, len - i, scale, out + i);
+  }
+}
+
+const soundview::SimdKernels& soundview::avx2_kernels() {
+  static const SimdKernels kernels = {
+    "AVX2",
+    pcm_to_float,
+    pcm_to_double,
+    magnitudes_float,
+    magnitudes_double,
+    magnitudes_q15,
+    abs_sum,
+    max_value,
+    quantize
+  };
+  return kernels;
+}
+
+#endif
@@ -0,0 +1,141 @@
+/* SoundView - Eye candy for your music
+ * Copyright (C) 2016 Nicholas Parker
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>. */
+
+
+#include "soundview/simd-kernels-impl.hpp"
+
+#ifdef SOUNDVIEW_SIMD_X86
+
+#include <algorithm>
+#include <immintrin.h>
+
+/* Built with -mavx512f. Anything left over after the last full vector is passed to the scalar
+ * kernels. */
+
+namespace {
+  void pcm_to_float(const int16_t* in, size_t len, float* out) {
+    size_t i = 0;
+    for (; i + 16 <= len; i += 16) {
+      const __m512i x = _mm512_cvtepi16_epi32(_mm256_loadu_si256((const __m256i*)(in + i)));
+      _mm512_storeu_ps(out + i, _mm512_cvtepi32_ps(x));
+    }
+    soundview::scalar_kernels().pcm_to_float(in + i, len - i, out + i);
+  }
+
+  void pcm_to_double(const int16_t* in, size_t len, double* out) {
+    size_t i = 0;
+    for (; i + 16 <= len; i += 16) {
+      const __m512i x = _mm512_cvtepi16_epi32(_mm256_loadu_si256((const __m256i*)(in + i)));
+      _mm512_storeu_pd(out + i, _mm512_cvtepi32_pd(_mm512_castsi512_si256(x)));
+      _mm512_storeu_pd(out + i + 8, _mm512_cvtepi32_pd(_mm512_extracti64x4_epi64(x, 1)));
+    }
+    soundview::scalar_kernels().pcm_to_double(in + i, len - i, out + i);
+  }
+
+  void magnitudes_float(const std::complex<float>* in, size_t len, soundview::freq_t* out) {
+    const float* in_f = reinterpret_cast<const float*>(in);
+    // picks the even (real) and odd (imaginary) floats out of a pair of vectors
+    const __m512i re_idx = _mm512_set_epi32(30, 28, 26, 24, 22, 20, 18, 16, 14, 12, 10, 8, 6, 4, 2, 0);
+    const __m512i im_idx = _mm512_set_epi32(31, 29, 27, 25, 23, 21, 19, 17, 15, 13, 11, 9, 7, 5, 3, 1);
+    size_t i = 0;
+    for (; i + 16 <= len; i += 16) {
+      const __m512 a = _mm512_loadu_ps(in_f + 2 * i), b = _mm512_loadu_ps(in_f + 2 * i + 16);
+      const __m512 re = _mm512_permutex2var_ps(a, re_idx, b);
+      const __m512 im = _mm512_permutex2var_ps(a, im_idx, b);
+      _mm512_storeu_ps(out + i,
+          _mm512_sqrt_ps(_mm512_add_ps(_mm512_mul_ps(re, re), _mm512_mul_ps(im, im))));
+    }
+    soundview::scalar_kernels().magnitudes_float(in + i, len - i, out + i);
+  }
+
+  void magnitudes_double(const std::complex<double>* in, size_t len, soundview::freq_t* out) {
+    const double* in_d = reinterpret_cast<const double*>(in);
+    const __m512i re_idx = _mm512_set_epi64(14, 12, 10, 8, 6, 4, 2, 0);
+    const __m512i im_idx = _mm512_set_epi64(15, 13, 11, 9, 7, 5, 3, 1);
+    size_t i = 0;
+    for (; i + 8 <= len; i += 8) {
+      const __m512d a = _mm512_loadu_pd(in_d + 2 * i), b = _mm512_loadu_pd(in_d + 2 * i + 8);
+      const __m512d re = _mm512_permutex2var_pd(a, re_idx, b);
+      const __m512d im = _mm512_permutex2var_pd(a, im_idx, b);
+      _mm256_storeu_ps(out + i, _mm512_cvtpd_ps(
+              _mm512_sqrt_pd(_mm512_add_pd(_mm512_mul_pd(re, re), _mm512_mul_pd(im, im)))));
+    }
+    soundview::scalar_kernels().magnitudes_double(in + i, len - i, out + i);
+  }
+
+  uint64_t abs_sum(const int16_t* in, size_t len) {
+    // each vector adds at most 32768 to a 32-bit lane, so flush the lanes into 'sum' often enough
+    // that they can't overflow
+    const size_t block_len = 16 * 65536;
+    uint64_t sum = 0;
+    size_t i = 0;
+    while (i + 16 <= len) {
+      const size_t block_end = i + std::min(block_len, (len - i) & ~(size_t)15);
+      __m512i acc = _mm512_setzero_si512();
+      for (; i < block_end; i += 16) {
+        const __m512i x = _mm512_cvtepi16_epi32(_mm256_loadu_si256((const __m256i*)(in + i)));
+        acc = _mm512_add_epi32(acc, _mm512_abs_epi32(x));
+      }
+      sum += _mm512_reduce_add_epi64(_mm512_add_epi64(
+              _mm512_cvtepu32_epi64(_mm512_castsi512_si256(acc)),
+              _mm512_cvtepu32_epi64(_mm512_extracti64x4_epi64(acc, 1))));
+    }
+    return sum + soundview::scalar_kernels().abs_sum(in + i, len - i);
+  }
+
+  soundview::freq_t max_value(const soundview::freq_t* in, size_t len, soundview::freq_t init) {
+    size_t i = 0;
+    if (len >= 16) {
+      __m512 max = _mm512_set1_ps(init);
+      for (; i + 16 <= len; i += 16) {
+        // NaN values are skipped like in the scalar loop: see sse2
+        max = _mm512_max_ps(_mm512_loadu_ps(in + i), max);
+      }
+      init = _mm512_reduce_max_ps(max);
+    }
+    return soundview::scalar_kernels().max_value(in + i, len - i, init);
+  }
+
+  void quantize(const soundview::freq_t* in, size_t len, float scale, uint8_t* out) {
+    const __m512 scale_v = _mm512_set1_ps(scale);
+    const __m512 half = _mm512_set1_ps(0.5f), zero = _mm512_setzero_ps(), top = _mm512_set1_ps(255);
+    size_t i = 0;
+    for (; i + 16 <= len; i += 16) {
+      const __m512 val = _mm512_add_ps(_mm512_mul_ps(_mm512_loadu_ps(in + i), scale_v), half);
+      const __m512i clamped = _mm512_cvttps_epi32(_mm512_min_ps(_mm512_max_ps(val, zero), top));
+      _mm_storeu_si128((__m128i*)(out + i), _mm512_cvtepi32_epi8(clamped));
+    }
+    soundview::scalar_kernels().quantize(in + i, len - i, scale, out + i);
+  }
+}
+
+const soundview::SimdKernels& soundview::avx512_kernels() {
+  static const SimdKernels kernels = {
+    "AVX-512",
+    pcm_to_float,
+    pcm_to_double,
+    magnitudes_float,
+    magnitudes_double,
+    // 512-bit multiplies of 16-bit values need AVX512BW, so stick with AVX2 for these
+    soundview::avx2_kernels().magnitudes_q15,
+    abs_sum,
+    max_value,
+    quantize
+  };
+  return kernels;
+}
+
+#endif
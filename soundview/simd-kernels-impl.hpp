@@ -0,0 +1,36 @@
+/* SoundView - Eye candy for your music
+ * Copyright (C) 2016 Nicholas Parker
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>. */
+
+
+#pragma once
+
+#include "soundview/simd-kernels.hpp"
+
+/* Kernels for specific instruction sets. Each lives in its own file which is built with the flags
+ * for that instruction set, so nothing else in the library ends up depending on them. Exported for
+ * the equivalence test and benchmark, which compare every set against the scalar kernels. */
+
+namespace soundview {
+
+  const SimdKernels& LIB_API scalar_kernels();
+
+#ifdef SOUNDVIEW_SIMD_X86
+  const SimdKernels& LIB_API sse2_kernels();
+  const SimdKernels& LIB_API avx2_kernels();
+  const SimdKernels& LIB_API avx512_kernels();
+#endif
+
+}
@@ -0,0 +1,181 @@
+/* SoundView - Eye candy for your music
+ * Copyright (C) 2016 Nicholas Parker
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>. */
+
+
+#include "soundview/simd-kernels-impl.hpp"
+
+#ifdef SOUNDVIEW_SIMD_X86
+
+#include <algorithm>
+#include <emmintrin.h>
+
+/* Built with -msse2. Anything left over after the last full vector is passed to the scalar
+ * kernels. */
+
+namespace {
+  // sign-extends the low/high four samples of x to 32 bits
+  inline __m128i widen_lo(__m128i x) {
+    return _mm_srai_epi32(_mm_unpacklo_epi16(x, x), 16);
+  }
+  inline __m128i widen_hi(__m128i x) {
+    return _mm_srai_epi32(_mm_unpackhi_epi16(x, x), 16);
+  }
+
+  void pcm_to_float(const int16_t* in, size_t len, float* out) {
+    size_t i = 0;
+    for (; i + 8 <= len; i += 8) {
+      const __m128i x = _mm_loadu_si128((const __m128i*)(in + i));
+      _mm_storeu_ps(out + i, _mm_cvtepi32_ps(widen_lo(x)));
+      _mm_storeu_ps(out + i + 4, _mm_cvtepi32_ps(widen_hi(x)));
+    }
+    soundview::scalar_kernels().pcm_to_float(in + i, len - i, out + i);
+  }
+
+  void pcm_to_double(const int16_t* in, size_t len, double* out) {
+    size_t i = 0;
+    for (; i + 8 <= len; i += 8) {
+      const __m128i x = _mm_loadu_si128((const __m128i*)(in + i));
+      const __m128i lo = widen_lo(x), hi = widen_hi(x);
+      _mm_storeu_pd(out + i, _mm_cvtepi32_pd(lo));
+      _mm_storeu_pd(out + i + 2, _mm_cvtepi32_pd(_mm_srli_si128(lo, 8)));
+      _mm_storeu_pd(out + i + 4, _mm_cvtepi32_pd(hi));
+      _mm_storeu_pd(out + i + 6, _mm_cvtepi32_pd(_mm_srli_si128(hi, 8)));
+    }
+    soundview::scalar_kernels().pcm_to_double(in + i, len - i, out + i);
+  }
+
+  void magnitudes_float(const std::complex<float>* in, size_t len, soundview::freq_t* out) {
+    const float* in_f = reinterpret_cast<const float*>(in);
+    size_t i = 0;
+    for (; i + 4 <= len; i += 4) {
+      const __m128 a = _mm_loadu_ps(in_f + 2 * i), b = _mm_loadu_ps(in_f + 2 * i + 4);
+      const __m128 re = _mm_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0));
+      const __m128 im = _mm_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1));
+      _mm_storeu_ps(out + i, _mm_sqrt_ps(_mm_add_ps(_mm_mul_ps(re, re), _mm_mul_ps(im, im))));
+    }
+    soundview::scalar_kernels().magnitudes_float(in + i, len - i, out + i);
+  }
+
+  // magnitudes of two complex values, still in double precision
+  inline __m128d magnitudes2(const double* in) {
+    const __m128d a = _mm_loadu_pd(in), b = _mm_loadu_pd(in + 2);
+    const __m128d re = _mm_unpacklo_pd(a, b), im = _mm_unpackhi_pd(a, b);
+    return _mm_sqrt_pd(_mm_add_pd(_mm_mul_pd(re, re), _mm_mul_pd(im, im)));
+  }
+
+  void magnitudes_double(const std::complex<double>* in, size_t len, soundview::freq_t* out) {
+    const double* in_d = reinterpret_cast<const double*>(in);
+    size_t i = 0;
+    for (; i + 4 <= len; i += 4) {
+      const __m128 lo = _mm_cvtpd_ps(magnitudes2(in_d + 2 * i));
+      const __m128 hi = _mm_cvtpd_ps(magnitudes2(in_d + 2 * i + 4));
+      _mm_storeu_ps(out + i, _mm_movelh_ps(lo, hi));
+    }
+    soundview::scalar_kernels().magnitudes_double(in + i, len - i, out + i);
+  }
+
+  // converts sums of squares to float, treating them as unsigned. a sum can only be negative when
+  // it's exactly 2^31
+  inline __m128 squares_to_float(__m128i sum) {
+    const __m128 val = _mm_cvtepi32_ps(sum);
+    return _mm_add_ps(val, _mm_and_ps(_mm_cmplt_ps(val, _mm_setzero_ps()), _mm_set1_ps(4294967296.f)));
+  }
+
+  void magnitudes_q15(const int16_t* in, size_t len, soundview::freq_t* out) {
+    size_t i = 0;
+    for (; i + 4 <= len; i += 4) {
+      const __m128i x = _mm_loadu_si128((const __m128i*)(in + 2 * i));
+      _mm_storeu_ps(out + i, _mm_sqrt_ps(squares_to_float(_mm_madd_epi16(x, x))));
+    }
+    soundview::scalar_kernels().magnitudes_q15(in + 2 * i, len - i, out + i);
+  }
+
+  inline __m128i abs_epi32(__m128i x) {
+    const __m128i sign = _mm_srai_epi32(x, 31);
+    return _mm_sub_epi32(_mm_xor_si128(x, sign), sign);
+  }
+
+  uint64_t abs_sum(const int16_t* in, size_t len) {
+    // each vector adds at most 2 * 32768 to a 32-bit lane, so flush the lanes into 'sum' often
+    // enough that they can't overflow
+    const size_t block_len = 8 * 32768;
+    uint64_t sum = 0;
+    size_t i = 0;
+    while (i + 8 <= len) {
+      const size_t block_end = i + std::min(block_len, (len - i) & ~(size_t)7);
+      __m128i acc = _mm_setzero_si128();
+      for (; i < block_end; i += 8) {
+        const __m128i x = _mm_loadu_si128((const __m128i*)(in + i));
+        acc = _mm_add_epi32(acc, _mm_add_epi32(abs_epi32(widen_lo(x)), abs_epi32(widen_hi(x))));
+      }
+      uint32_t lanes[4];
+      _mm_storeu_si128((__m128i*)lanes, acc);
+      sum += (uint64_t)lanes[0] + lanes[1] + lanes[2] + lanes[3];
+    }
+    return sum + soundview::scalar_kernels().abs_sum(in + i, len - i);
+  }
+
+  soundview::freq_t max_value(const soundview::freq_t* in, size_t len, soundview::freq_t init) {
+    size_t i = 0;
+    if (len >= 4) {
+      __m128 max = _mm_set1_ps(init);
+      for (; i + 4 <= len; i += 4) {
+        // maxps returns its second operand when either is NaN, so NaN values are skipped like in
+        // the scalar loop
+        max = _mm_max_ps(_mm_loadu_ps(in + i), max);
+      }
+      max = _mm_max_ps(max, _mm_shuffle_ps(max, max, _MM_SHUFFLE(1, 0, 3, 2)));
+      max = _mm_max_ps(max, _mm_shuffle_ps(max, max, _MM_SHUFFLE(2, 3, 0, 1)));
+      init = _mm_cvtss_f32(max);
+    }
+    return soundview::scalar_kernels().max_value(in + i, len - i, init);
+  }
+
+  // scales, rounds and clamps four values to 0-255. maxps returns zero for NaN values
+  inline __m128i quantize4(const float* in, __m128 scale) {
+    const __m128 val = _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(in), scale), _mm_set1_ps(0.5f));
+    return _mm_cvttps_epi32(
+        _mm_min_ps(_mm_max_ps(val, _mm_setzero_ps()), _mm_set1_ps(255)));
+  }
+
+  void quantize(const soundview::freq_t* in, size_t len, float scale, uint8_t* out) {
+    const __m128 scale_v = _mm_set1_ps(scale);
+    size_t i = 0;
+    for (; i + 16 <= len; i += 16) {
+      const __m128i lo = _mm_packs_epi32(quantize4(in + i, scale_v), quantize4(in + i + 4, scale_v));
+      const __m128i hi = _mm_packs_epi32(quantize4(in + i + 8, scale_v), quantize4(in + i + 12, scale_v));
+      _mm_storeu_si128((__m128i*)(out + i), _mm_packus_epi16(lo, hi));
+    }
+    soundview::scalar_kernels().quantize(in + i, len - i, scale, out + i);
+  }
+}
+
+const soundview::SimdKernels& soundview::sse2_kernels() {
+  static const SimdKernels kernels = {
+    "SSE2",
+    pcm_to_float,
+    pcm_to_double,
+    magnitudes_float,
+    magnitudes_double,
+    magnitudes_q15,
+    abs_sum,
+    max_value,
+    quantize
+  };
+  return kernels;
+}
+
+#endif
@@ -0,0 +1,127 @@
+/* SoundView - Eye candy for your music
+ * Copyright (C) 2016 Nicholas Parker
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>. */
+
+
+#include <cmath>
+
+#include "soundview/simd-kernels-impl.hpp"
+
+namespace {
+  void pcm_to_float(const int16_t* in, size_t len, float* out) {
+    for (size_t i = 0; i < len; ++i) {
+      out[i] = in[i];
+    }
+  }
+
+  void pcm_to_double(const int16_t* in, size_t len, double* out) {
+    for (size_t i = 0; i < len; ++i) {
+      out[i] = in[i];
+    }
+  }
+
+  template <typename T>
+  void magnitudes(const std::complex<T>* in, size_t len, soundview::freq_t* out) {
+    // not std::abs(), which avoids overflow at the cost of being far slower. FFTs of 16-bit
+    // samples are nowhere near overflowing
+    for (size_t i = 0; i < len; ++i) {
+      const T re = in[i].real(), im = in[i].imag();
+      out[i] = std::sqrt(re * re + im * im);
+    }
+  }
+
+  void magnitudes_q15(const int16_t* in, size_t len, soundview::freq_t* out) {
+    for (size_t i = 0; i < len; ++i) {
+      const int32_t re = in[2 * i], im = in[2 * i + 1];
+      // only overflows int32 when both are -32768, so sum as unsigned
+      const uint32_t sum = (uint32_t)(re * re) + (uint32_t)(im * im);
+      out[i] = std::sqrt((float)sum);
+    }
+  }
+
+  uint64_t abs_sum(const int16_t* in, size_t len) {
+    uint64_t sum = 0;
+    for (size_t i = 0; i < len; ++i) {
+      sum += std::abs((int32_t)in[i]);
+    }
+    return sum;
+  }
+
+  soundview::freq_t max_value(const soundview::freq_t* in, size_t len, soundview::freq_t init) {
+    for (size_t i = 0; i < len; ++i) {
+      if (in[i] > init) {
+        init = in[i];
+      }
+    }
+    return init;
+  }
+
+  void quantize(const soundview::freq_t* in, size_t len, float scale, uint8_t* out) {
+    for (size_t i = 0; i < len; ++i) {
+      float val = in[i] * scale + 0.5f;
+      // also catches NaN, which is undefined to convert to an integer
+      if (!(val >= 0)) {
+        val = 0;
+      } else if (val > 255) {
+        val = 255;
+      }
+      out[i] = (uint8_t)val;
+    }
+  }
+
+  const soundview::SimdKernels& detect_kernels() {
+#ifdef SOUNDVIEW_SIMD_X86
+    // checks CPUID, along with whether the OS saves the wider registers
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f")) {
+      return soundview::avx512_kernels();
+    }
+    if (__builtin_cpu_supports("avx2")) {
+      return soundview::avx2_kernels();
+    }
+    if (__builtin_cpu_supports("sse2")) {
+      return soundview::sse2_kernels();
+    }
+#endif
+    return soundview::scalar_kernels();
+  }
+
+  const soundview::SimdKernels& select_kernels() {
+    const soundview::SimdKernels& kernels = detect_kernels();
+    LOG("Using %s DSP kernels", kernels.name);
+    return kernels;
+  }
+}
+
+const soundview::SimdKernels& soundview::scalar_kernels() {
+  static const SimdKernels kernels = {
+    "scalar",
+    pcm_to_float,
+    pcm_to_double,
+    magnitudes<float>,
+    magnitudes<double>,
+    magnitudes_q15,
+    abs_sum,
+    max_value,
+    quantize
+  };
+  return kernels;
+}
+
+const soundview::SimdKernels& soundview::simd_kernels() {
+  // initialized once, even if the first calls come from several threads at once
+  static const SimdKernels& kernels = select_kernels();
+  return kernels;
+}
@@ -0,0 +1,87 @@
+/* SoundView - Eye candy for your music
+ * Copyright (C) 2016 Nicholas Parker
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>. */
+
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <algorithm>
+#include <complex>
+
+#include "soundview/config.hpp"
+#include "soundview/frame.hpp"
+
+namespace soundview {
+
+  /**
+   * The per-sample and per-bucket loops which run on every block of audio and every frame. Each
+   * kernel has a scalar implementation, along with SSE2, AVX2 and AVX-512 ones on x86 builds.
+   * The fastest set supported by the CPU is picked the first time any kernel is used.
+   *
+   * The vectorized kernels produce the same results as the scalar ones, so which set is picked
+   * doesn't affect what's displayed.
+   */
+  struct SimdKernels {
+    // name of the instruction set used by these kernels, for logging
+    const char* name;
+
+    // converts 16-bit samples to floating point for the FFT
+    void (*pcm_to_float)(const int16_t* in, size_t len, float* out);
+    void (*pcm_to_double)(const int16_t* in, size_t len, double* out);
+
+    // writes the magnitude of each complex value, ie sqrt(re^2 + im^2)
+    void (*magnitudes_float)(const std::complex<float>* in, size_t len, freq_t* out);
+    void (*magnitudes_double)(const std::complex<double>* in, size_t len, freq_t* out);
+    // same for 'len' Q15 complex values, stored as interleaved pairs of real and imaginary parts
+    void (*magnitudes_q15)(const int16_t* in, size_t len, freq_t* out);
+
+    // returns the sum of the absolute values of some samples
+    uint64_t (*abs_sum)(const int16_t* in, size_t len);
+
+    // returns the largest of 'init' and the values in 'in'. NaN values are ignored
+    freq_t (*max_value)(const freq_t* in, size_t len, freq_t init);
+
+    // writes each value multiplied by 'scale' and rounded, clamped to 0-255. NaN is written as 0
+    void (*quantize)(const freq_t* in, size_t len, float scale, uint8_t* out);
+  };
+
+  /**
+   * Returns the kernels to use on this CPU. Picked once, then reused on every call.
+   */
+  const SimdKernels& LIB_API simd_kernels();
+
+  /**
+   * Overloads for callers which are templated on FFT precision.
+   */
+  inline void simd_pcm_to_fft(const int16_t* in, size_t len, float* out) {
+    simd_kernels().pcm_to_float(in, len, out);
+  }
+  inline void simd_pcm_to_fft(const int16_t* in, size_t len, double* out) {
+    simd_kernels().pcm_to_double(in, len, out);
+  }
+  inline void simd_pcm_to_fft(const int16_t* in, size_t len, int16_t* out) {
+    // the fixed-point engine uses samples as they are
+    std::copy(in, in + len, out);
+  }
+  inline void simd_magnitudes(const std::complex<float>* in, size_t len, freq_t* out) {
+    simd_kernels().magnitudes_float(in, len, out);
+  }
+  inline void simd_magnitudes(const std::complex<double>* in, size_t len, freq_t* out) {
+    simd_kernels().magnitudes_double(in, len, out);
+  }
+
+}
@@ -17,29 +17,115 @@
 #include "soundview/config.hpp"
 #include "soundview/sound-recorder.hpp"
 
-soundview::SoundRecorder::SoundRecorder(const Options& options, buf_func_t freq_output_cb)
-  : buf(options, freq_output_cb) {
+namespace {
+  // how much audio the PCM ring can hold before the capture thread has to drop samples
+  const size_t RING_SECS = 1;
+
+  soundview::Transformer* new_transformer(const soundview::Options& options,
+      soundview::FramePool& pool, soundview::FrameReducer& reducer,
+      soundview::buf_func_t freq_output_cb) {
+    if (options.fft_engine() == "q15") {
+      return new soundview::TransformerBuffer<int16_t>(options, pool, reducer, freq_output_cb);
+    }
+    if (options.fft_precision() == "float") {
+#ifdef SOUNDVIEW_FFTW_FLOAT
+      return new soundview::TransformerBuffer<float>(options, pool, reducer, freq_output_cb);
+#else
+      if (options.fft_engine() != "fftw") {
+        return new soundview::TransformerBuffer<float>(options, pool, reducer, freq_output_cb);
+      }
+      ERROR("Single precision FFT support wasn't included in this build, using double");
+#endif
+    }
+    return new soundview::TransformerBuffer<double>(options, pool, reducer, freq_output_cb);
+  }
+}
+
+soundview::SoundRecorder::SoundRecorder(
+    const Options& options, FramePool& pool, FrameReducer& reducer, buf_func_t freq_output_cb)
+  : sample_rate_hz(options.audio_sample_rate_hz()),
+    buf(new_transformer(options, pool, reducer, freq_output_cb)),
+    ring(sample_rate_hz * RING_SECS, options.audio_collect_rate_hz() * RING_SECS),
+    wake_interval(1000000 / options.audio_collect_rate_hz()),
+    stopping(false) {
   auto period = sf::seconds(1 / ((double)options.audio_collect_rate_hz()));
   setProcessingInterval(period);
 }
 
+soundview::SoundRecorder::~SoundRecorder() {
+  // in case the recorder was destroyed without being stopped
+  stop_analysis();
+}
+
+bool soundview::SoundRecorder::onStart() {
+  stopping = false;
+  analysis_thread = std::thread(&SoundRecorder::run_analysis, this);
+  return true;
+}
+
 bool soundview::SoundRecorder::onProcessSamples(const int16_t* samples, size_t samples_len) {
-  int64_t sum = 0;
-  int16_t val = 0;
-  for (size_t i = 0; i < samples_len; ++i) {
-    val = samples[i];
-    if (val < 0) {
-      sum -= val;
-    } else {
-      sum += val;
-    }
+  // runs on SFML's capture thread: just hand the samples off to the analysis thread, which picks
+  // them up the next time it checks the ring
+  if (!ring.write(samples, samples_len, frame_clock_t::now())) {
+    DEBUG("PCM ring full, dropped %lu samples", samples_len);
   }
-  DEBUG("got %lu samples, sum=%ld", samples_len, sum);
-  buf.add(samples, samples_len);
   return true;
 }
 
 void soundview::SoundRecorder::onStop() {
-  buf.reset();
+  stop_analysis();
+  LOG("PCM ring: %lu blocks written, %lu overruns (%lu samples dropped), peak %lu/%lu samples",
+      ring.written(), ring.overruns(), ring.overrun_samples(), ring.max_fill(), ring.capacity());
 }
 
+void soundview::SoundRecorder::run_analysis() {
+  PcmBlock block;
+  for (;;) {
+    // check 'stopping' before draining the ring, so that nothing written before it was set is
+    // missed
+    const bool stop = stopping;
+    while (ring.read(block)) {
+      DEBUG("got %lu samples", block.len[0] + block.len[1]);
+      if (block.len[1] != 0) {
+        // the block wraps around the end of the ring. the first part ended when the second part's
+        // samples started to arrive
+        buf->add(block.data[0], block.len[0],
+            block.timestamp - std::chrono::duration_cast<frame_clock_t::duration>(
+                std::chrono::duration<double>(block.len[1] / (double) sample_rate_hz)));
+        buf->add(block.data[1], block.len[1], block.timestamp);
+      } else {
+        buf->add(block.data[0], block.len[0], block.timestamp);
+      }
+      ring.release(block);
+    }
+    if (stop) {
+      break;
+    }
+    wait_for_samples();
+  }
+  buf->reset();
+}
+
+void soundview::SoundRecorder::wait_for_samples() {
+  // the capture thread doesn't wake us, so that it never has to take wake_mutex. instead we check
+  // the ring once per collect period, which is how often the device delivers samples anyway
+  std::unique_lock<std::mutex> lock(wake_mutex);
+  if (ring.empty() && !stopping) {
+    wake_cond.wait_for(lock, wake_interval);
+  }
+}
+
+void soundview::SoundRecorder::stop_analysis() {
+  if (!analysis_thread.joinable()) {
+    return;
+  }
+  // the analysis thread finishes whatever is left in the ring before exiting
+  // taking the lock ensures that the analysis thread is either not yet waiting, or is already
+  // inside wait_for()
+  {
+    std::lock_guard<std::mutex> lock(wake_mutex);
+    stopping = true;
+    wake_cond.notify_one();
+  }
+  analysis_thread.join();
+}
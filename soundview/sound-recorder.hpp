@@ -16,27 +16,55 @@
 
 #pragma once
 
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
 #include <memory>
+#include <mutex>
+#include <thread>
 
 #include <SFML/Audio/SoundRecorder.hpp>
 
+#include "soundview/pcm-ring.hpp"
 #include "soundview/transformer-buffer.hpp"
 
 namespace soundview {
 
   /**
    * Implementation for retrieving audio samples from a device.
+   *
+   * SFML's capture thread only copies samples into a PcmRing, so that it's never held up by
+   * analysis. A separate analysis thread, running while the device is recording, owns the
+   * Transformer and passes the samples from the ring to it.
    */
   class LIB_API SoundRecorder : public sf::SoundRecorder {
    public:
-    SoundRecorder(const Options& options, buf_func_t freq_output_cb);
+    SoundRecorder(const Options& options, FramePool& pool, FrameReducer& reducer,
+        buf_func_t freq_output_cb);
+    virtual ~SoundRecorder();
 
    protected:
+    bool onStart();
     bool onProcessSamples(const int16_t* samples, size_t samples_len);
     void onStop();
 
    private:
-    TransformerBuffer buf;
+    void run_analysis();
+    void wait_for_samples();
+    void stop_analysis();
+
+    const size_t sample_rate_hz;
+    std::unique_ptr<Transformer> buf;
+    PcmRing ring;
+
+    // when the ring is empty, the analysis thread sleeps on wake_cond for up to wake_interval. the
+    // capture thread never touches wake_mutex, which is only used to wake the analysis thread when
+    // it's being stopped.
+    std::thread analysis_thread;
+    const std::chrono::microseconds wake_interval;
+    std::mutex wake_mutex;
+    std::condition_variable wake_cond;
+    std::atomic<bool> stopping;
   };
 
 }
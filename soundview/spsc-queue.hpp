@@ -0,0 +1,153 @@
+/* SoundView - Eye candy for your music
+ * Copyright (C) 2016 Nicholas Parker
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>. */
+
+#pragma once
+
+#include <atomic>
+#include <vector>
+
+namespace soundview {
+
+  /**
+   * Bounded wait-free queue for passing values from a single producer thread to a single consumer
+   * thread. The read and write indices are kept on separate cache lines so that the two threads
+   * don't contend with each other, and each side keeps a cached copy of the other side's index
+   * so that it only needs to read the shared copy when the queue looks full/empty.
+   */
+  template <typename T>
+  class SpscQueue {
+   public:
+    /**
+     * Creates a queue with room for at least 'min_capacity' values.
+     */
+    SpscQueue(size_t min_capacity)
+      : buf(round_up_pow2(min_capacity)),
+        mask(buf.size() - 1),
+        c(),
+        p() { }
+
+    /**
+     * Adds a value to the queue, or returns false if the queue is full. Producer thread only.
+     */
+    bool push(const T& val) {
+      const size_t t = p.tail.load(std::memory_order_relaxed);
+      if (t - p.head_cached == buf.size()) {
+        p.head_cached = c.head.load(std::memory_order_acquire);
+        if (t - p.head_cached == buf.size()) {
+          p.dropped.store(p.dropped.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+          return false;
+        }
+      }
+      buf[t & mask] = val;
+      p.tail.store(t + 1, std::memory_order_release);
+      return true;
+    }
+
+    /**
+     * Removes the oldest value from the queue into 'val', or returns false if the queue is empty.
+     * Consumer thread only.
+     */
+    bool pop(T& val) {
+      const size_t h = c.head.load(std::memory_order_relaxed);
+      if (h == c.tail_cached) {
+        c.tail_cached = p.tail.load(std::memory_order_acquire);
+        if (h == c.tail_cached) {
+          return false;
+        }
+      }
+      val = buf[h & mask];
+      c.head.store(h + 1, std::memory_order_release);
+      return true;
+    }
+
+    /**
+     * Returns whether the queue has nothing to pop. Consumer thread only.
+     */
+    bool empty() {
+      const size_t h = c.head.load(std::memory_order_relaxed);
+      if (h == c.tail_cached) {
+        c.tail_cached = p.tail.load(std::memory_order_acquire);
+      }
+      return h == c.tail_cached;
+    }
+
+    /**
+     * Returns the maximum number of values which may be in the queue at once.
+     */
+    size_t capacity() const {
+      return buf.size();
+    }
+
+    // Counters, which may be read from any thread:
+
+    /**
+     * Returns the total number of values which have been successfully pushed.
+     */
+    size_t enqueued() const {
+      return p.tail.load(std::memory_order_relaxed);
+    }
+
+    /**
+     * Returns the total number of values which have been popped.
+     */
+    size_t dequeued() const {
+      return c.head.load(std::memory_order_relaxed);
+    }
+
+    /**
+     * Returns the total number of values which were rejected because the queue was full.
+     */
+    size_t dropped() const {
+      return p.dropped.load(std::memory_order_relaxed);
+    }
+
+   private:
+    static const size_t CACHE_LINE = 64;
+
+    static size_t round_up_pow2(size_t val) {
+      size_t ret = 1;
+      while (ret < val) {
+        ret <<= 1;
+      }
+      return ret;
+    }
+
+    // consumer side: total values popped, and the consumer's latest copy of 'tail'.
+    // leading padding keeps this off the cache line holding 'buf' and 'mask', which both sides read
+    struct Consumer {
+      Consumer() : head(0), tail_cached(0) { }
+      char pad_before[CACHE_LINE];
+      std::atomic<size_t> head;
+      size_t tail_cached;
+      char pad[CACHE_LINE - sizeof(std::atomic<size_t>) - sizeof(size_t)];
+    };
+
+    // producer side: total values pushed, the producer's latest copy of 'head', and push failures
+    struct Producer {
+      Producer() : tail(0), head_cached(0), dropped(0) { }
+      std::atomic<size_t> tail;
+      size_t head_cached;
+      std::atomic<size_t> dropped;
+      char pad[CACHE_LINE - (2 * sizeof(std::atomic<size_t>)) - sizeof(size_t)];
+    };
+
+    std::vector<T> buf;
+    const size_t mask;
+    Consumer c;
+    Producer p;
+  };
+
+}
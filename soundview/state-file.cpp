@@ -0,0 +1,54 @@
+/* SoundView - Eye candy for your music
+ * Copyright (C) 2016 Nicholas Parker
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>. */
+
+#include <errno.h>
+
+#ifdef WIN32
+// think different
+#include <direct.h>
+#define MKDIR(x) _mkdir(x)
+#define PATH_SEP "\\"
+#else
+#include <sys/stat.h>
+#define MKDIR(x) mkdir(x, 0755)
+#define PATH_SEP "/"
+#endif
+
+#include "soundview/config.hpp"
+#include "soundview/state-file.hpp"
+
+namespace {
+  bool make_dir(const std::string& path) {
+    return MKDIR(path.c_str()) == 0 || errno == EEXIST;
+  }
+}
+
+std::string soundview::state_file_path(const std::string& state_dir, const std::string& name) {
+  if (state_dir.empty()) {
+    return std::string();
+  }
+  // create any missing parent directories, then the state dir itself
+  for (size_t i = 1; i < state_dir.size(); ++i) {
+    if (state_dir[i] == '/' || state_dir[i] == '\\') {
+      make_dir(state_dir.substr(0, i));
+    }
+  }
+  if (!make_dir(state_dir)) {
+    ERROR("Failed to create state directory %s, state won't be kept", state_dir.c_str());
+    return std::string();
+  }
+  return state_dir + PATH_SEP + name;
+}
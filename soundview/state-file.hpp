@@ -0,0 +1,30 @@
+/* SoundView - Eye candy for your music
+ * Copyright (C) 2016 Nicholas Parker
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>. */
+
+#pragma once
+
+#include <string>
+
+namespace soundview {
+
+  /**
+   * Returns the path to a file named 'name' within 'state_dir', where persistent state such as
+   * FFTW wisdom may be kept across runs. 'state_dir' is created if it doesn't exist yet. Returns
+   * an empty string if 'state_dir' is empty (state disabled) or couldn't be created.
+   */
+  std::string state_file_path(const std::string& state_dir, const std::string& name);
+
+}
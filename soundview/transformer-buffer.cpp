@@ -15,9 +15,12 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>. */
 
 #include "soundview/config.hpp"
+#include "soundview/simd-kernels.hpp"
 #include "soundview/transformer-buffer.hpp"
 
-#include <fftw3.h>
+#include <math.h>
+#include <algorithm>
+#include <chrono>
 
 #ifdef WIN32
 // no std::min
@@ -26,67 +29,295 @@
 #define MIN(x,y) (std::min(x,y))
 #endif
 
-// Double the size of the fft_plan buffers: Everything past halfway is zero
-soundview::TransformerBuffer::TransformerBuffer(
-    const Options& options, buf_func_t freq_output_cb)
+namespace {
+  const double TWO_PI = 6.28318530717958647692;
+  // upper limit on frames per batch, in case of a tiny hop with a slow collect rate
+  const size_t MAX_BATCH_SIZE = 64;
+
+  size_t get_hop(const soundview::Options& options) {
+    size_t hop = options.fft_hop();
+    if (hop == 0) {
+      // automatic: produce frames at roughly the rate that they're displayed
+      hop = options.audio_sample_rate_hz() / options.display_fps_max();
+    }
+    return (hop == 0) ? 1 : hop;
+  }
+
+  /**
+   * Returns the FFT length to use: the requested --fft-size (or twice the bucket count by default),
+   * rounded to the nearest even 2^a * 3^b * 5^c. FFTW has fast codelets for these factors, while
+   * lengths with other prime factors can be several times slower to transform. The bundled
+   * engines only support powers of two.
+   */
+  size_t get_fft_len(const soundview::Options& options) {
+    // at least two bins, so that there's always a pair to interpolate between
+    const size_t requested = std::max<size_t>(4, (options.fft_size() == 0)
+        ? options.bucket_count() * 2 : options.fft_size());
+    // there's always a power of two between 'requested' and twice that, so look no further
+    const size_t limit = requested * 2;
+    const size_t max_radix = soundview::fft_engine_mixed_radix(options) ? 5 : 2;
+    size_t best = 4;
+    for (size_t p2 = 2; p2 <= limit; p2 *= 2) {
+      for (size_t p3 = p2; p3 <= limit && (p3 == p2 || max_radix >= 3); p3 *= 3) {
+        for (size_t p5 = p3; p5 <= limit && (p5 == p3 || max_radix >= 5); p5 *= 5) {
+          const size_t dist = (p5 > requested) ? p5 - requested : requested - p5;
+          const size_t best_dist = (best > requested) ? best - requested : requested - best;
+          // on a tie, prefer the larger size for its finer frequency resolution
+          if (dist < best_dist || (dist == best_dist && p5 > best)) {
+            best = p5;
+          }
+        }
+      }
+    }
+    if (options.fft_size() != 0 && best != options.fft_size()) {
+      LOG("Rounded FFT size %lu to %lu", options.fft_size(), best);
+    }
+    return best;
+  }
+
+  size_t get_batch_size(const soundview::Options& options, size_t hop) {
+    // enough for all the frames which complete within a typical callback from the device
+    const size_t samples_per_collect =
+      options.audio_sample_rate_hz() / options.audio_collect_rate_hz();
+    const size_t batch_size = samples_per_collect / hop + 1;
+    return (batch_size > MAX_BATCH_SIZE) ? MAX_BATCH_SIZE : batch_size;
+  }
+
+  /**
+   * Converts a window coefficient in 0-1 to the sample type: as-is for floating point, or Q15.
+   */
+  template <typename T>
+  T window_coeff(double val) {
+    return val;
+  }
+  template <>
+  int16_t window_coeff(double val) {
+    return (int16_t) lround(val * 32767);
+  }
+
+  /**
+   * Applies a window coefficient to a sample.
+   */
+  template <typename T>
+  T apply_window(T sample, T coeff) {
+    return sample * coeff;
+  }
+  template <>
+  int16_t apply_window(int16_t sample, int16_t coeff) {
+    return (int16_t) (((int32_t) sample * coeff + (1 << 14)) >> 15);
+  }
+
+  /**
+   * Returns the coefficients for the named window function. Uses the periodic form of each
+   * function, which is what you want when frames are overlapped.
+   */
+  template <typename T>
+  soundview::aligned_vector<T> get_window(const std::string& name, size_t size) {
+    soundview::aligned_vector<T> window(size, window_coeff<T>(1));
+    if (name == "hann") {
+      for (size_t i = 0; i < size; ++i) {
+        window[i] = window_coeff<T>(0.5 - 0.5 * cos(TWO_PI * i / size));
+      }
+    } else if (name == "blackman") {
+      for (size_t i = 0; i < size; ++i) {
+        window[i] = window_coeff<T>(
+            0.42 - 0.5 * cos(TWO_PI * i / size) + 0.08 * cos(2 * TWO_PI * i / size));
+      }
+    } else if (name != "none") {
+      ERROR("Unknown window function '%s', using none", name.c_str());
+    }
+    return window;
+  }
+}
+
+// The FFT of N real samples produces N/2 useful frequency values (bins), which are resampled to the
+// bucket count if it's different.
+template <typename T>
+soundview::TransformerBuffer<T>::TransformerBuffer(
+    const Options& options, FramePool& pool, FrameReducer& reducer, buf_func_t freq_output_cb)
   : bucket_count(options.bucket_count()),
-    buf_pcm(bucket_count * 2, 0),
-    buf_pcm_filled(0),
-    buf_complex(bucket_count * 2, std::complex<double>(0,0)),
-    buf_freq(bucket_count, 0),
-    fft_plan(fftw_plan_dft_r2c_1d(
-            bucket_count * 2,
-            buf_pcm.data(),
-            reinterpret_cast<fftw_complex*>(buf_complex.data()),
-            0 /* flags */)),
+    sample_rate_hz(options.audio_sample_rate_hz()),
+    fft_len(get_fft_len(options)),
+    bin_count(fft_len / 2),
+    hop(get_hop(options)),
+    batch_size(get_batch_size(options, hop)),
+    pcm_dist(aligned_len<T>(fft_len)),
+    complex_dist(aligned_len<typename FftComplex<T>::type>(fft_len / 2 + 1)),
+    window(get_window<T>(options.fft_window(), fft_len)),
+    buf_ring(fft_len, 0),
+    buf_ring_pos(0),
+    samples_until_frame(fft_len),
+    buf_pcm(batch_size * pcm_dist, 0),
+    buf_pcm_frames(0),
+    buf_pcm_times(batch_size),
+    buf_complex(batch_size * complex_dist, typename FftComplex<T>::type()),
+    buf_bins((bin_count != bucket_count) ? bin_count : 0, 0),
+    bucket_bin_start(),
+    bucket_bin_end(),
+    bucket_bin_weight(),
+    buf_magnitudes(bucket_count, 0),
+    out_frames(),
+    next_seq(0),
+    engine(),
+    pool(pool),
+    reducer(reducer),
     freq_output_cb(freq_output_cb) {
-  if (!fft_plan) {
-    ERROR("FFT Plan construction failed");
+  out_frames.reserve(batch_size);
+  if (bin_count > bucket_count) {
+    // each bucket takes the loudest of the bins which overlap it, like the reducer does for pixels
+    bucket_bin_start.resize(bucket_count);
+    bucket_bin_end.resize(bucket_count);
+    for (size_t b = 0; b < bucket_count; ++b) {
+      bucket_bin_start[b] = (b * bin_count) / bucket_count;
+      bucket_bin_end[b] = ((b + 1) * bin_count + bucket_count - 1) / bucket_count;
+    }
+  } else if (bin_count < bucket_count) {
+    // each bucket is interpolated between the two bins nearest to its center
+    bucket_bin_start.resize(bucket_count);
+    bucket_bin_weight.resize(bucket_count);
+    for (size_t b = 0; b < bucket_count; ++b) {
+      double pos = (b + 0.5) * bin_count / bucket_count - 0.5;
+      pos = std::max(0., std::min(pos, (double)(bin_count - 1)));
+      const size_t bin = std::min((size_t)pos, bin_count - 2);
+      bucket_bin_start[b] = bin;
+      bucket_bin_weight[b] = pos - bin;
+    }
   }
+  FftBuffers<T> buffers;
+  buffers.len = fft_len;
+  buffers.frames = batch_size;
+  buffers.in = buf_pcm.data();
+  buffers.in_dist = pcm_dist;
+  buffers.out = buf_complex.data();
+  buffers.out_dist = complex_dist;
+  engine.reset(new_fft_engine(options, buffers));
+  DEBUG("FFT length %lu (%lu bins for %lu buckets), hop %lu, batch %lu, %lu-bit precision",
+      fft_len, bin_count, bucket_count, hop, batch_size, sizeof(T) * 8);
 }
 
-soundview::TransformerBuffer::~TransformerBuffer() {
-  fftw_destroy_plan(fft_plan);
-  fftw_cleanup();
-}
+template <typename T>
+soundview::TransformerBuffer<T>::~TransformerBuffer() { }
 
-void soundview::TransformerBuffer::add(const int16_t* samples, size_t samples_len) {
-  // append samples to buf. as buf limit is reached (>=0 times), transform and emit transformed
+template <typename T>
+void soundview::TransformerBuffer<T>::add(const int16_t* samples, size_t samples_len,
+    frame_clock_t::time_point timestamp) {
+  // append samples to ring. each time enough new samples have arrived (>=0 times), transform
+  // the most recent samples and emit transformed
   size_t samples_offset = 0;
-  for (;;) {
+  while (samples_offset < samples_len) {
     size_t copy_size = MIN(
-        samples_len - samples_offset, // remaining samples to copy
-        buf_pcm.size() - buf_pcm_filled); // remaining space in buffer
-    {
-      double* out_ptr = buf_pcm.data() + buf_pcm_filled;
-      for (size_t i = 0; i < copy_size; ++i) {
-        // direct converstion to dbl for fft:
-        *out_ptr = samples[samples_offset + i];
-        ++out_ptr;
-      }
-    }
-    buf_pcm_filled += copy_size;
-    if (buf_pcm_filled == buf_pcm.size()) {
-      transform_and_flush();
-      buf_pcm_filled = 0;
+        MIN(samples_len - samples_offset, // remaining samples to copy
+            buf_ring.size() - buf_ring_pos), // remaining space before ring wraps
+        samples_until_frame); // remaining samples before next frame is due
+    // direct conversion to float/dbl for fft:
+    simd_pcm_to_fft(samples + samples_offset, copy_size, buf_ring.data() + buf_ring_pos);
+    buf_ring_pos += copy_size;
+    if (buf_ring_pos == buf_ring.size()) {
+      buf_ring_pos = 0;
     }
     samples_offset += copy_size;
-    if (samples_offset == samples_len) {
-      break;
+    samples_until_frame -= copy_size;
+    if (samples_until_frame == 0) {
+      // the last sample in this frame arrived before any samples remaining in this call
+      window_into_batch(timestamp - std::chrono::duration_cast<frame_clock_t::duration>(
+              std::chrono::duration<double>((samples_len - samples_offset) / (double) sample_rate_hz)));
+      if (buf_pcm_frames == batch_size) {
+        transform_and_flush();
+      }
+      samples_until_frame = hop;
     }
   }
+  if (buf_pcm_frames != 0) {
+    transform_and_flush();
+  }
+}
+
+template <typename T>
+void soundview::TransformerBuffer<T>::reset() {
+  // wait for the ring to be completely refilled before producing another frame
+  buf_ring_pos = 0;
+  samples_until_frame = fft_len;
+  buf_pcm_frames = 0;
+}
+
+template <typename T>
+void soundview::TransformerBuffer<T>::window_into_batch(frame_clock_t::time_point timestamp) {
+  // unroll buf_ring into the next frame of buf_pcm (oldest first) while applying the window
+  T* frame = buf_pcm.data() + (buf_pcm_frames * pcm_dist);
+  const size_t oldest_len = fft_len - buf_ring_pos;
+  for (size_t i = 0; i < oldest_len; ++i) {
+    frame[i] = apply_window(buf_ring[buf_ring_pos + i], window[i]);
+  }
+  for (size_t i = oldest_len; i < fft_len; ++i) {
+    frame[i] = apply_window(buf_ring[i - oldest_len], window[i]);
+  }
+  buf_pcm_times[buf_pcm_frames] = timestamp;
+  ++buf_pcm_frames;
 }
 
-void soundview::TransformerBuffer::reset() {
-  buf_pcm_filled = 0;
+template <typename T>
+void soundview::TransformerBuffer<T>::transform_and_flush() {
+  // transform buf_pcm -> buf_complex
+  engine->transform(buf_pcm_frames);
+  // write magnitudes of buf_complex into pooled frames, reducing them to one value per display
+  // pixel if the display has asked for that, then send the frames
+  reducer.update();
+  const bool reduce = reducer.active();
+  for (size_t f = 0; f < buf_pcm_frames; ++f) {
+    const uint64_t seq = next_seq++;
+    Frame* frame = pool.acquire();
+    if (frame == NULL) {
+      // display has fallen behind and is holding all the frames. drop this one
+      DEBUG("no free frames, dropping frame %lu", seq);
+      continue;
+    }
+    const typename FftComplex<T>::type* complex_frame = buf_complex.data() + (f * complex_dist);
+    freq_t* magnitudes = reduce ? buf_magnitudes.data() : frame->data;
+    if (bin_count == bucket_count) {
+      simd_magnitudes(complex_frame, bucket_count, magnitudes);
+    } else {
+      simd_magnitudes(complex_frame, bin_count, buf_bins.data());
+      resample_bins(magnitudes);
+    }
+    if (reduce) {
+      reducer.reduce(buf_magnitudes.data(), frame);
+    } else {
+      frame->len = bucket_count;
+      frame->reduced = 0;
+    }
+    frame->seq = seq;
+    frame->timestamp = buf_pcm_times[f];
+    out_frames.push_back(frame);
+  }
+  buf_pcm_frames = 0;
+  if (!out_frames.empty()) {
+    freq_output_cb(out_frames);
+    out_frames.clear();
+  }
 }
 
-void soundview::TransformerBuffer::transform_and_flush() {
-  // transform buf_pcm -> buf_complex -> buf_freq, then send buf_freq
-  fftw_execute(fft_plan); // converts buf_pcm => buf_complex
-  const size_t size = buf_freq.size();
-  for (size_t i = 0; i < size; ++i) {
-    buf_freq[i] = std::abs(buf_complex[i]);
+template <typename T>
+void soundview::TransformerBuffer<T>::resample_bins(freq_t* out) const {
+  const freq_t* bins = buf_bins.data();
+  if (bucket_bin_weight.empty()) {
+    for (size_t b = 0; b < bucket_count; ++b) {
+      freq_t val = bins[bucket_bin_start[b]];
+      for (uint32_t i = bucket_bin_start[b] + 1; i < bucket_bin_end[b]; ++i) {
+        if (bins[i] > val) {
+          val = bins[i];
+        }
+      }
+      out[b] = val;
+    }
+  } else {
+    for (size_t b = 0; b < bucket_count; ++b) {
+      const freq_t* pair = bins + bucket_bin_start[b];
+      const freq_t weight = bucket_bin_weight[b];
+      out[b] = pair[0] + (pair[1] - pair[0]) * weight;
+    }
   }
-  freq_output_cb(buf_freq);
 }
+
+template class soundview::TransformerBuffer<double>;
+template class soundview::TransformerBuffer<float>;
+template class soundview::TransformerBuffer<int16_t>;
@@ -21,40 +21,114 @@
 #include <memory>
 #include <vector>
 
+#include "soundview/aligned-allocator.hpp"
 #include "soundview/config.hpp"
+#include "soundview/fft-engine.hpp"
+#include "soundview/frame-pool.hpp"
+#include "soundview/frame-reducer.hpp"
 #include "soundview/options.hpp"
 
-struct fftw_plan_s;
-
 namespace soundview {
 
-  typedef std::function<void(const std::vector<double>&)> buf_func_t;
+  /**
+   * Receives ownership of one or more frames, which must each be returned to their FramePool.
+   */
+  typedef std::function<void(const std::vector<Frame*>&)> buf_func_t;
+
+  /**
+   * Interface for transforming PCM data to frequency data, independent of FFT precision.
+   */
+  class LIB_API Transformer {
+   public:
+    virtual ~Transformer() { }
+
+    /**
+     * Adds samples from the device, where 'timestamp' is when the last of them was received.
+     */
+    virtual void add(const int16_t* samples, size_t samples_len,
+        frame_clock_t::time_point timestamp) = 0;
+    virtual void reset() = 0;
+  };
 
   /**
-   * Transfroms PCM data to frequency data (via FFT)
+   * Transfroms PCM data to frequency data (via FFT). Frames are taken from a sliding window over
+   * the most recent samples, so that consecutive frames may overlap (a short-time fourier transform).
+   * All frames which become ready within a single add() are transformed together as one batch.
+   * The FFT length is independent of the bucket count: it's rounded to a size which FFTW handles
+   * quickly, and the resulting frequency bins are resampled to buckets when the two don't match.
+   * Output frames are taken from a FramePool and filled in place, reduced to display pixels by the
+   * FrameReducer when the display has provided a map.
+   * T is the sample type used for the FFT: double or float, or int16_t for the fixed-point Q15
+   * engine. The FFT itself is run by an FftEngine. All buffers used by the FFT are aligned to
+   * BUFFER_ALIGNMENT, which lets FFTW use its SIMD codelets.
    */
-  class LIB_API TransformerBuffer {
+  template <typename T>
+  class TransformerBuffer : public Transformer {
    public:
-    TransformerBuffer(const Options& options, buf_func_t freq_output_cb);
+    TransformerBuffer(const Options& options, FramePool& pool, FrameReducer& reducer,
+        buf_func_t freq_output_cb);
     virtual ~TransformerBuffer();
 
-    void add(const int16_t* samples, size_t samples_len);
+    void add(const int16_t* samples, size_t samples_len, frame_clock_t::time_point timestamp);
     void reset();
 
    private:
+    void window_into_batch(frame_clock_t::time_point timestamp);
     void transform_and_flush();
+    void resample_bins(freq_t* out) const;
 
     const size_t bucket_count;
-    // fixed-size buffer containing pcm data from device
-    std::vector<double> buf_pcm;
-    // number of used elements in buf_pcm
-    size_t buf_pcm_filled;
-    // fixed-size buffer containing raw FFT of buf_pcm
-    std::vector<std::complex<double>> buf_complex;
-    // fixed-size buffer containing magnitudes derived from buf_complex
-    std::vector<double> buf_freq;
-
-    fftw_plan_s* fft_plan;
+    const size_t sample_rate_hz;
+    // number of samples in each frame passed to the FFT
+    const size_t fft_len;
+    // number of frequency bins used from the FFT of each frame, from 0Hz up to (but excluding) the
+    // nyquist frequency
+    const size_t bin_count;
+    // number of new samples to collect between the start of one frame and the start of the next
+    const size_t hop;
+    // maximum number of frames which are transformed together in one batch
+    const size_t batch_size;
+    // distance between consecutive frames in buf_pcm, padded so that every frame in a batch has
+    // the same alignment as the first. this lets the single-frame plan, which is created against
+    // the first frame, be reused against any other frame
+    const size_t pcm_dist;
+    // distance between consecutive frames in buf_complex, padded in the same way
+    const size_t complex_dist;
+    // fixed-size window function to apply against the samples in each frame
+    const aligned_vector<T> window;
+    // fixed-size ring buffer containing the most recent pcm data from device
+    aligned_vector<T> buf_ring;
+    // the position in buf_ring of the next sample to be written (ie the oldest sample)
+    size_t buf_ring_pos;
+    // number of samples to collect before the next frame is transformed
+    size_t samples_until_frame;
+    // fixed-size buffer containing up to batch_size frames of windowed pcm data from buf_ring
+    aligned_vector<T> buf_pcm;
+    // number of frames currently in buf_pcm
+    size_t buf_pcm_frames;
+    // fixed-size buffer containing the time of the last sample of each frame in buf_pcm
+    std::vector<frame_clock_t::time_point> buf_pcm_times;
+    // fixed-size buffer containing raw FFT of each frame in buf_pcm
+    aligned_vector<typename FftComplex<T>::type> buf_complex;
+    // fixed-size buffer containing the magnitudes of one frame's bins, when they're resampled
+    aligned_vector<freq_t> buf_bins;
+    // for each bucket, when there are at least as many bins as buckets: the range of bins whose
+    // largest value is used for the bucket. otherwise: the pair of bins to interpolate between,
+    // and the weight of the second one
+    std::vector<uint32_t> bucket_bin_start;
+    std::vector<uint32_t> bucket_bin_end;
+    std::vector<freq_t> bucket_bin_weight;
+    // fixed-size buffer containing the magnitudes of one frame, before it's reduced
+    aligned_vector<freq_t> buf_magnitudes;
+    // frames being passed to freq_output_cb, reserved to batch_size
+    std::vector<Frame*> out_frames;
+    // sequence number to assign to the next frame
+    uint64_t next_seq;
+
+    // transforms buf_pcm into buf_complex
+    std::unique_ptr<FftEngine<T>> engine;
+    FramePool& pool;
+    FrameReducer& reducer;
     buf_func_t freq_output_cb;
   };
 
@@ -0,0 +1,220 @@
+/* SoundView - Eye candy for your music
+ * Copyright (C) 2016 Nicholas Parker
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>. */
+
+
+#include <stdio.h>
+#include <algorithm>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+#include "soundview/pcm-ring.hpp"
+
+/* Checks PcmRing's blocks and counters: blocks which wrap around the end of the ring, overruns when
+ * it's full, and space being returned by release(). Exits nonzero if anything is wrong. */
+
+namespace {
+  size_t failures = 0;
+
+  void check(bool ok, const char* what, size_t line) {
+    if (!ok) {
+      fprintf(stderr, "FAIL line %lu: %s\n", line, what);
+      ++failures;
+    }
+  }
+#define CHECK(expr) check((expr), #expr, __LINE__)
+
+  /**
+   * Returns 'len' samples counting up from 'start'.
+   */
+  std::vector<int16_t> samples(size_t start, size_t len) {
+    std::vector<int16_t> ret(len);
+    for (size_t i = 0; i < len; ++i) {
+      ret[i] = start + i;
+    }
+    return ret;
+  }
+
+  /**
+   * Returns whether the block holds 'len' samples counting up from 'start', across both parts.
+   */
+  bool block_matches(const soundview::PcmBlock& block, size_t start, size_t len) {
+    if (block.len[0] + block.len[1] != len) {
+      return false;
+    }
+    size_t i = 0;
+    for (size_t part = 0; part < 2; ++part) {
+      for (size_t j = 0; j < block.len[part]; ++j, ++i) {
+        if (block.data[part][j] != (int16_t)(start + i)) {
+          return false;
+        }
+      }
+    }
+    return true;
+  }
+
+  void test_wrap_and_overrun() {
+    soundview::PcmRing ring(16, 4);
+    CHECK(ring.capacity() == 16);
+    CHECK(ring.empty());
+    const soundview::frame_clock_t::time_point now = soundview::frame_clock_t::now();
+    soundview::PcmBlock block;
+
+    // fits without wrapping
+    CHECK(ring.write(samples(0, 10).data(), 10, now));
+    CHECK(ring.max_fill() == 10);
+    CHECK(ring.read(block));
+    CHECK(block.len[1] == 0);
+    CHECK(block_matches(block, 0, 10));
+    CHECK(block.timestamp == now);
+    ring.release(block);
+    CHECK(!ring.read(block));
+
+    // starts at 10 in a ring of 16, so it's split across the end
+    CHECK(ring.write(samples(10, 10).data(), 10, now));
+    CHECK(ring.read(block));
+    CHECK(block.len[0] == 6);
+    CHECK(block.len[1] == 4);
+    CHECK(block_matches(block, 10, 10));
+
+    // the block hasn't been released, so only 6 samples are free
+    CHECK(!ring.write(samples(20, 10).data(), 10, now));
+    CHECK(ring.overruns() == 1);
+    CHECK(ring.overrun_samples() == 10);
+    CHECK(ring.written() == 2);
+    CHECK(ring.max_fill() == 10);
+
+    // releasing it frees all 16, which can then be filled exactly
+    ring.release(block);
+    CHECK(ring.write(samples(20, 10).data(), 10, now));
+    CHECK(ring.write(samples(30, 6).data(), 6, now));
+    CHECK(ring.max_fill() == 16);
+    CHECK(!ring.write(samples(36, 1).data(), 1, now));
+    CHECK(ring.overruns() == 2);
+    CHECK(ring.overrun_samples() == 11);
+
+    // the dropped samples never show up
+    CHECK(ring.read(block));
+    CHECK(block_matches(block, 20, 10));
+    ring.release(block);
+    CHECK(ring.read(block));
+    CHECK(block_matches(block, 30, 6));
+    ring.release(block);
+    CHECK(!ring.read(block));
+    CHECK(ring.empty());
+    CHECK(ring.written() == 4);
+  }
+
+  void test_block_overrun() {
+    // plenty of samples, but only room for 2 blocks
+    soundview::PcmRing ring(1024, 2);
+    const soundview::frame_clock_t::time_point now = soundview::frame_clock_t::now();
+    CHECK(ring.write(samples(0, 1).data(), 1, now));
+    CHECK(ring.write(samples(1, 1).data(), 1, now));
+    CHECK(!ring.write(samples(2, 1).data(), 1, now));
+    CHECK(ring.overruns() == 1);
+    CHECK(ring.overrun_samples() == 1);
+    CHECK(ring.max_fill() == 2);
+
+    soundview::PcmBlock block;
+    CHECK(ring.read(block));
+    CHECK(block_matches(block, 0, 1));
+    ring.release(block);
+    CHECK(ring.write(samples(3, 1).data(), 1, now));
+    CHECK(ring.read(block));
+    CHECK(block_matches(block, 1, 1));
+    ring.release(block);
+    CHECK(ring.read(block));
+    CHECK(block_matches(block, 3, 1));
+    ring.release(block);
+  }
+
+  void test_threads() {
+    // a small ring and a reader which stalls now and then, so that the writer overruns. every
+    // sample in block 'b' is the low bits of 'b', so that blocks which were accepted can be checked
+    // for arriving intact and in order
+    const size_t BLOCKS = 100000;
+    const size_t BLOCK_LEN = 37;
+    soundview::PcmRing ring(256, 8);
+    std::vector<int16_t> accepted;
+    accepted.reserve(BLOCKS);
+
+    std::thread writer([&]() {
+      std::vector<int16_t> buf(BLOCK_LEN);
+      for (size_t b = 0; b < BLOCKS; ++b) {
+        std::fill(buf.begin(), buf.end(), (int16_t)(b & 0x7fff));
+        if (ring.write(buf.data(), BLOCK_LEN, soundview::frame_clock_t::now())) {
+          accepted.push_back(buf[0]);
+        }
+        // like a device delivering samples periodically, and lets the reader run on a single core
+        std::this_thread::yield();
+      }
+    });
+
+    std::vector<int16_t> received;
+    received.reserve(BLOCKS);
+    size_t torn_blocks = 0;
+    soundview::PcmBlock block;
+    for (;;) {
+      // check whether the writer is done before reading, so that no blocks are left behind
+      const bool done = ring.written() + ring.overruns() == BLOCKS;
+      while (ring.read(block)) {
+        const int16_t val = block.data[0][0];
+        for (size_t part = 0; part < 2; ++part) {
+          for (size_t i = 0; i < block.len[part]; ++i) {
+            if (block.data[part][i] != val) {
+              ++torn_blocks;
+            }
+          }
+        }
+        if (block.len[0] + block.len[1] != BLOCK_LEN) {
+          ++torn_blocks;
+        }
+        received.push_back(val);
+        ring.release(block);
+        if (received.size() % 1000 == 0) {
+          std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+      }
+      if (done) {
+        break;
+      }
+      std::this_thread::yield();
+    }
+    writer.join();
+
+    CHECK(torn_blocks == 0);
+    CHECK(ring.overruns() > 0);
+    CHECK(received == accepted);
+    CHECK(ring.written() == accepted.size());
+    CHECK(ring.overrun_samples() == ring.overruns() * BLOCK_LEN);
+    CHECK(ring.max_fill() <= ring.capacity());
+    printf("Threads: %lu blocks written, %lu overruns, peak %lu/%lu samples\n",
+        ring.written(), ring.overruns(), ring.max_fill(), ring.capacity());
+  }
+}
+
+int main() {
+  test_wrap_and_overrun();
+  test_block_overrun();
+  test_threads();
+  if (failures != 0) {
+    fprintf(stderr, "%lu failures\n", failures);
+    return 1;
+  }
+  printf("PcmRing checks passed\n");
+  return 0;
+}
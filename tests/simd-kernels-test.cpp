@@ -0,0 +1,242 @@
+/* SoundView - Eye candy for your music
+ * Copyright (C) 2016 Nicholas Parker
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>. */
+
+
+#include <math.h>
+#include <stdio.h>
+#include <limits>
+#include <random>
+#include <vector>
+
+#include "soundview/simd-kernels-impl.hpp"
+
+/* Checks that every set of vectorized kernels which this CPU can run gives the same results as the
+ * scalar kernels, across lengths which cover the vector loops, their tails, and neither. Exits
+ * nonzero if anything differs. */
+
+namespace {
+  // longest input to check, long enough for several iterations of the widest vector loop
+  const size_t MAX_LEN = 300;
+  // extra values past the end of each output, which no kernel may write
+  const size_t GUARD_LEN = 16;
+
+  size_t failures = 0;
+
+  void fail(const soundview::SimdKernels& kernels, const char* kernel, const char* input,
+      size_t len, size_t pos) {
+    fprintf(stderr, "FAIL %s %s (%s input): len=%lu differs from scalar at %lu\n",
+        kernels.name, kernel, input, len, pos);
+    ++failures;
+  }
+
+  bool same(float a, float b) {
+    return (isnan(a) && isnan(b)) || a == b;
+  }
+  bool same(double a, double b) {
+    return (isnan(a) && isnan(b)) || a == b;
+  }
+  bool same(uint8_t a, uint8_t b) {
+    return a == b;
+  }
+
+  /**
+   * Compares two outputs, including the guard values after 'len'. Returns the first position
+   * which differs, or -1 if they're the same.
+   */
+  template <typename T>
+  long compare(const std::vector<T>& a, const std::vector<T>& b) {
+    for (size_t i = 0; i < a.size(); ++i) {
+      if (!same(a[i], b[i])) {
+        return i;
+      }
+    }
+    return -1;
+  }
+
+  /**
+   * Test inputs of a given length. 'special' replaces some values with NaN and infinities.
+   */
+  struct Inputs {
+    Inputs(size_t len, bool special, std::mt19937& rng)
+      : pcm(len), cfloat(len), cdouble(len), q15(2 * len), values(len) {
+      std::uniform_int_distribution<int> pcm_dist(-32768, 32767);
+      std::uniform_real_distribution<double> val_dist(-1e6, 1e6);
+      for (size_t i = 0; i < len; ++i) {
+        pcm[i] = pcm_dist(rng);
+        q15[2 * i] = pcm_dist(rng);
+        q15[2 * i + 1] = pcm_dist(rng);
+        const double re = val_dist(rng), im = val_dist(rng);
+        cfloat[i] = std::complex<float>(re, im);
+        cdouble[i] = std::complex<double>(re, im);
+        values[i] = fabs(val_dist(rng)) / 1e3;
+      }
+      // the extremes of each integer type, where vectorized integer math is most likely to overflow
+      if (len >= 2) {
+        pcm[0] = -32768;
+        pcm[len - 1] = 32767;
+        q15[0] = q15[1] = -32768;
+      }
+      if (special) {
+        const float fnan = std::numeric_limits<float>::quiet_NaN();
+        const float finf = std::numeric_limits<float>::infinity();
+        const double dnan = std::numeric_limits<double>::quiet_NaN();
+        const double dinf = std::numeric_limits<double>::infinity();
+        for (size_t i = 0; i < len; i += 3) {
+          switch ((i / 3) % 3) {
+            case 0:
+              values[i] = fnan;
+              cfloat[i] = std::complex<float>(fnan, 1);
+              cdouble[i] = std::complex<double>(1, dnan);
+              break;
+            case 1:
+              values[i] = finf;
+              cfloat[i] = std::complex<float>(1, finf);
+              cdouble[i] = std::complex<double>(dinf, 1);
+              break;
+            case 2:
+              values[i] = -finf;
+              cfloat[i] = std::complex<float>(-finf, 1);
+              cdouble[i] = std::complex<double>(1, -dinf);
+              break;
+          }
+        }
+      }
+    }
+
+    std::vector<int16_t> pcm;
+    std::vector<std::complex<float>> cfloat;
+    std::vector<std::complex<double>> cdouble;
+    std::vector<int16_t> q15;
+    std::vector<soundview::freq_t> values;
+  };
+
+  void check(const soundview::SimdKernels& k, const Inputs& in, const char* input) {
+    const soundview::SimdKernels& s = soundview::scalar_kernels();
+    const size_t len = in.pcm.size();
+    long pos;
+
+    {
+      std::vector<float> expect(len + GUARD_LEN, 7), actual(len + GUARD_LEN, 7);
+      s.pcm_to_float(in.pcm.data(), len, expect.data());
+      k.pcm_to_float(in.pcm.data(), len, actual.data());
+      if ((pos = compare(expect, actual)) >= 0) {
+        fail(k, "pcm_to_float", input, len, pos);
+      }
+    }
+    {
+      std::vector<double> expect(len + GUARD_LEN, 7), actual(len + GUARD_LEN, 7);
+      s.pcm_to_double(in.pcm.data(), len, expect.data());
+      k.pcm_to_double(in.pcm.data(), len, actual.data());
+      if ((pos = compare(expect, actual)) >= 0) {
+        fail(k, "pcm_to_double", input, len, pos);
+      }
+    }
+    {
+      std::vector<soundview::freq_t> expect(len + GUARD_LEN, 7), actual(len + GUARD_LEN, 7);
+      s.magnitudes_float(in.cfloat.data(), len, expect.data());
+      k.magnitudes_float(in.cfloat.data(), len, actual.data());
+      if ((pos = compare(expect, actual)) >= 0) {
+        fail(k, "magnitudes_float", input, len, pos);
+      }
+    }
+    {
+      std::vector<soundview::freq_t> expect(len + GUARD_LEN, 7), actual(len + GUARD_LEN, 7);
+      s.magnitudes_double(in.cdouble.data(), len, expect.data());
+      k.magnitudes_double(in.cdouble.data(), len, actual.data());
+      if ((pos = compare(expect, actual)) >= 0) {
+        fail(k, "magnitudes_double", input, len, pos);
+      }
+    }
+    {
+      std::vector<soundview::freq_t> expect(len + GUARD_LEN, 7), actual(len + GUARD_LEN, 7);
+      s.magnitudes_q15(in.q15.data(), len, expect.data());
+      k.magnitudes_q15(in.q15.data(), len, actual.data());
+      if ((pos = compare(expect, actual)) >= 0) {
+        fail(k, "magnitudes_q15", input, len, pos);
+      }
+    }
+    if (s.abs_sum(in.pcm.data(), len) != k.abs_sum(in.pcm.data(), len)) {
+      fail(k, "abs_sum", input, len, 0);
+    }
+    const soundview::freq_t inits[] = {0, -std::numeric_limits<float>::infinity(), 500, 1e9};
+    for (soundview::freq_t init : inits) {
+      const soundview::freq_t expect = s.max_value(in.values.data(), len, init);
+      if (!same(expect, k.max_value(in.values.data(), len, init))) {
+        fail(k, "max_value", input, len, 0);
+      }
+    }
+    const float scales[] = {0, 0.3f, 255 / 1e3f, 1e30f, std::numeric_limits<float>::infinity()};
+    for (float scale : scales) {
+      std::vector<uint8_t> expect(len + GUARD_LEN, 7), actual(len + GUARD_LEN, 7);
+      s.quantize(in.values.data(), len, scale, expect.data());
+      k.quantize(in.values.data(), len, scale, actual.data());
+      if ((pos = compare(expect, actual)) >= 0) {
+        fail(k, "quantize", input, len, pos);
+      }
+    }
+  }
+
+  std::vector<const soundview::SimdKernels*> supported_kernels() {
+    std::vector<const soundview::SimdKernels*> ret;
+#ifdef SOUNDVIEW_SIMD_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("sse2")) {
+      ret.push_back(&soundview::sse2_kernels());
+    }
+    if (__builtin_cpu_supports("avx2")) {
+      ret.push_back(&soundview::avx2_kernels());
+    }
+    if (__builtin_cpu_supports("avx512f")) {
+      ret.push_back(&soundview::avx512_kernels());
+    }
+#endif
+    return ret;
+  }
+}
+
+int main() {
+  const std::vector<const soundview::SimdKernels*> kernels = supported_kernels();
+  if (kernels.empty()) {
+    printf("No vectorized kernels for this build/CPU, nothing to compare\n");
+    return 0;
+  }
+
+  std::mt19937 rng(1);
+  for (size_t len = 0; len <= MAX_LEN; ++len) {
+    const Inputs normal(len, false, rng), special(len, true, rng);
+    for (const soundview::SimdKernels* k : kernels) {
+      check(*k, normal, "normal");
+      check(*k, special, "NaN/inf");
+    }
+  }
+
+  // enough maximum samples to overflow any 32-bit lane which isn't flushed to the total in time
+  const std::vector<int16_t> loud(1 << 20, -32768);
+  for (const soundview::SimdKernels* k : kernels) {
+    if (k->abs_sum(loud.data(), loud.size()) != 32768ull * loud.size()) {
+      fail(*k, "abs_sum", "all -32768", loud.size(), 0);
+    }
+  }
+
+  for (const soundview::SimdKernels* k : kernels) {
+    printf("Checked %s kernels against scalar\n", k->name);
+  }
+  if (failures != 0) {
+    fprintf(stderr, "%lu failures\n", failures);
+    return 1;
+  }
+  return 0;
+}